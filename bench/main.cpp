@@ -0,0 +1,782 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+//Micro benchmarks of TouchDriver and OneFingerFSM on synthetic input.
+//Every scenario is a scripted evdev stream in memory, replayed through the driver as fast
+//as possible; FSM gets the driver's output directly. Geometry kernels (Geometry.h) run on
+//64 point windows next to plain per-sample loops. Build Release for meaningful numbers.
+//--check also verifies what the numbers promise and exits non-zero if something broke.
+//
+//  gestlib_bench [--json] [--min-ms N] [--filter text] [--check]
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <new>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <linux/input.h>
+
+#include "gestlib/GestLib.h"
+#include "gestlib/Geometry.h"
+
+using namespace GestLib;
+
+//every heap allocation in the process; benchmarks are single threaded, --check runs recognizer threads
+static std::atomic<std::uint64_t> allocations{0};
+
+//every form of new is replaced and counted, every delete frees the same way (malloc/free), so no pair is mismatched
+static void * allocate(std::size_t size, std::size_t align = 0) noexcept {
+    ++allocations;
+    if(size == 0) size = 1;
+    if(align <= alignof(std::max_align_t)) return std::malloc(size);
+    void * ptr = nullptr;
+    return posix_memalign(&ptr, align, size) == 0 ? ptr : nullptr;
+}
+
+static void * allocateOrThrow(std::size_t size, std::size_t align = 0) {
+    if(void * ptr = allocate(size, align)) return ptr;
+    throw std::bad_alloc();
+}
+
+void * operator new(std::size_t size) { return allocateOrThrow(size); }
+void * operator new[](std::size_t size) { return allocateOrThrow(size); }
+void * operator new(std::size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<std::size_t>(align)); }
+void * operator new[](std::size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<std::size_t>(align)); }
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void * operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return allocate(size, static_cast<std::size_t>(align));
+}
+void * operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+void operator delete[](void * ptr) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
+
+constexpr int RESOLUTION = 4095;
+constexpr int SLOTS = 10;
+constexpr int FRAME_US = 8000; //125Hz, typical touchscreen
+
+//builds a capture (Capture.h) frame by frame
+class Script {
+    public:
+    explicit Script(int frameUs = FRAME_US) : _slotId(SLOTS, -1), _frameUs(frameUs) {
+        CaptureHeader header = {};
+        header.magic = CAPTURE_MAGIC;
+        header.version = CAPTURE_VERSION;
+        header.slots = SLOTS;
+        header.x.maximum = RESOLUTION;
+        header.y.maximum = RESOLUTION;
+        std::strncpy(header.uniq, "gestlib-bench", sizeof(header.uniq) - 1);
+        append(&header, sizeof(header));
+    }
+
+    //finger goes down or moves
+    void touch(int slot, int x, int y) {
+        emit(EV_ABS, ABS_MT_SLOT, slot);
+        if(_slotId[slot] < 0) {
+            _slotId[slot] = _nextId++;
+            emit(EV_ABS, ABS_MT_TRACKING_ID, _slotId[slot]);
+        }
+        emit(EV_ABS, ABS_MT_POSITION_X, x);
+        emit(EV_ABS, ABS_MT_POSITION_Y, y);
+    }
+
+    void lift(int slot) {
+        if(_slotId[slot] < 0) return;
+        emit(EV_ABS, ABS_MT_SLOT, slot);
+        emit(EV_ABS, ABS_MT_TRACKING_ID, -1);
+        _slotId[slot] = -1;
+    }
+
+    bool down(int slot) const { return _slotId[slot] >= 0; }
+
+    void frame() {
+        ++_frames;
+        emit(EV_SYN, SYN_REPORT, 0);
+        _timeUs += _frameUs;
+    }
+
+    //driver times fingers out on frame time, so idle time is empty frames - what recognizer's ticks do live
+    void wait(int ms) {
+        for(int i = 0; i < ms * 1000 / _frameUs; ++i) frame();
+    }
+
+    std::size_t events() const { return _events; }
+    std::size_t frames() const { return _frames; }
+    const std::vector<unsigned char> & data() const { return _data; }
+
+    private:
+    std::vector<unsigned char> _data;
+    std::vector<int> _slotId;
+    int _frameUs;
+    int _nextId = 1;
+    int64_t _timeUs = 1000000;
+    std::size_t _events = 0;
+    std::size_t _frames = 0;
+
+    void emit(uint16_t type, uint16_t code, int32_t value) {
+        CaptureRecord rec = { _timeUs, type, code, value };
+        append(&rec, sizeof(rec));
+        ++_events;
+    }
+
+    void append(const void * ptr, std::size_t size) {
+        const unsigned char * bytes = static_cast<const unsigned char*>(ptr);
+        _data.insert(_data.end(), bytes, bytes + size);
+    }
+};
+
+//real fingers never hold perfectly still, and driver only promotes fingers that report
+static void still(Script & s, int slot, int x, int y, int frames) {
+    for(int i = 0; i < frames; ++i) {
+        s.touch(slot, x + (i & 1), y);
+        s.frame();
+    }
+}
+
+//second tap comes after the driver ended the first finger, well within tap timeout
+static void doubleTap(Script & s, int x, int y) {
+    for(int tap = 0; tap < 2; ++tap) {
+        still(s, 0, x, y, 6);
+        s.lift(0);
+        s.frame();
+        s.wait(120);
+    }
+}
+
+static Script taps(int count = 200) {
+    Script s;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pos(200, RESOLUTION - 200);
+    for(int i = 0; i < count; ++i) {
+        still(s, 0, pos(rng), pos(rng), 8);
+        s.lift(0);
+        s.frame();
+        s.wait(400);
+    }
+    return s;
+}
+
+static Script drags() {
+    Script s;
+    for(int i = 0; i < 20; ++i) {
+        int x = 500;
+        int y = 500 + i * 100;
+        still(s, 0, x, y, 40);
+        for(int f = 0; f < 250; ++f) {
+            x += 10;
+            s.touch(0, x, y + (f & 1));
+            s.frame();
+        }
+        s.lift(0);
+        s.frame();
+        s.wait(400);
+    }
+    return s;
+}
+
+//tap, then touch again and go round a few times: double tap circular, the trig heavy path
+static Script circles() {
+    Script s;
+    const float pi = 3.14159265f;
+    for(int i = 0; i < 20; ++i) {
+        int cx = 2000;
+        int cy = 2000;
+        int radius = 80; //driver reports moves of 2..30px, FSM wants a full turn in ~10 of them
+        still(s, 0, cx + radius, cy, 6);
+        s.lift(0);
+        s.frame();
+        s.wait(120);
+        for(int f = 0; f <= 120; ++f) {
+            float angle = f * (2.0f * pi / 20);
+            s.touch(0, cx + static_cast<int>(radius * std::cos(angle)), cy + static_cast<int>(radius * std::sin(angle)));
+            s.frame();
+        }
+        s.lift(0);
+        s.frame();
+        s.wait(400);
+    }
+    return s;
+}
+
+//five fingers landing, wandering and lifting at random
+static Script chaos() {
+    Script s;
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> pos(100, RESOLUTION - 100);
+    std::uniform_int_distribution<int> step(-20, 20);
+    std::uniform_int_distribution<int> dice(0, 99);
+    std::vector<Vec2i> at(5, Vec2i{0, 0});
+    for(int f = 0; f < 3000; ++f) {
+        for(int slot = 0; slot < 5; ++slot) {
+            if(!s.down(slot)) {
+                if(dice(rng) < 10) {
+                    at[slot] = { pos(rng), pos(rng) };
+                    s.touch(slot, at[slot].x, at[slot].y);
+                }
+            } else if(dice(rng) < 4) {
+                s.lift(slot);
+            } else {
+                at[slot].x = std::min(RESOLUTION, std::max(0, at[slot].x + step(rng)));
+                at[slot].y = std::min(RESOLUTION, std::max(0, at[slot].y + step(rng)));
+                s.touch(slot, at[slot].x, at[slot].y);
+            }
+        }
+        s.frame();
+    }
+    for(int slot = 0; slot < 5; ++slot) s.lift(slot);
+    s.frame();
+    return s;
+}
+
+struct Frame {
+    std::chrono::time_point<std::chrono::steady_clock> time;
+    std::vector<TouchEvent> touches;
+};
+
+struct Result {
+    std::string suite;
+    std::string scenario;
+    std::uint64_t iterations;
+    std::uint64_t events;       //per iteration: input_events for driver, touches for FSM
+    double nsPerEvent;
+    double allocsPerEvent;
+    double gesturesPerSecond;
+};
+
+//repeats body until minMs passed, body returns {events, gestures} of one run
+template<typename Body>
+static Result measure(const std::string & suite, const std::string & scenario, int minMs, Body body) {
+    using clock = std::chrono::steady_clock;
+    std::uint64_t iterations = 0;
+    std::uint64_t events = 0;
+    std::uint64_t gestures = 0;
+    std::uint64_t allocs = 0;
+    clock::duration spent(0);
+
+    //first run warms caches and lets vectors reach their final size
+    body(spent, allocs);
+    spent = clock::duration(0);
+    allocs = 0;
+
+    while(spent < std::chrono::milliseconds(minMs) || iterations < 3) {
+        std::pair<std::uint64_t, std::uint64_t> run = body(spent, allocs);
+        events += run.first;
+        gestures += run.second;
+        ++iterations;
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(spent).count();
+    Result r;
+    r.suite = suite;
+    r.scenario = scenario;
+    r.iterations = iterations;
+    r.events = events / iterations;
+    r.nsPerEvent = events ? ns / events : 0;
+    r.allocsPerEvent = events ? static_cast<double>(allocs) / events : 0;
+    r.gesturesPerSecond = ns > 0 ? gestures / (ns / 1e9) : 0;
+    return r;
+}
+
+//everything driver produces from the script, input for FSM runs
+static std::vector<Frame> driverOutput(const Script & script) {
+    std::vector<Frame> frames;
+    TouchDriver driver;
+    if(!driver.initReplayBuffer(script.data().data(), script.data().size(), false)) return frames;
+    std::vector<TouchEvent> touches;
+    while(driver.getFrame(touches)) {
+        frames.push_back({ driver.now(), touches });
+    }
+    driver.shutdown();
+    return frames;
+}
+
+static Result benchDriver(const std::string & name, const Script & script, int minMs) {
+    TouchDriver driver;
+    std::vector<TouchEvent> touches;
+    return measure("driver", name, minMs, [&](std::chrono::steady_clock::duration & spent, std::uint64_t & allocs) {
+        //replay setup (eventfd) stays out of the numbers
+        driver.initReplayBuffer(script.data().data(), script.data().size(), false);
+
+        std::uint64_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        while(driver.getFrame(touches)) {}
+        spent += std::chrono::steady_clock::now() - start;
+        allocs += allocations - before;
+
+        driver.shutdown();
+        return std::make_pair(static_cast<std::uint64_t>(script.events()), std::uint64_t(0));
+    });
+}
+
+//the same dispatch GestureRecognizer does, plus timer deadlines between frames
+static Result benchFsm(const std::string & name, const std::vector<Frame> & frames, int minMs) {
+    GestureRecognizer recognizer;
+    std::uint64_t gestures = 0;
+    recognizer.onGesture([&gestures](const Gesture &) { ++gestures; });
+    OneFingerFSM fsm(recognizer);
+    fsm.init(RESOLUTION, RESOLUTION);
+    fsm.expectedResolution(1920, 1080);
+
+    std::vector<std::vector<TouchEvent>> touches;
+    std::uint64_t events = 0;
+    for(const Frame & f : frames) {
+        touches.push_back(f.touches);
+        events += f.touches.size();
+    }
+
+    return measure("fsm", name, minMs, [&](std::chrono::steady_clock::duration & spent, std::uint64_t & allocs) {
+        fsm.reset();
+        gestures = 0;
+
+        std::uint64_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::time_point<std::chrono::steady_clock> deadline;
+        for(std::size_t i = 0; i < frames.size(); ++i) {
+            std::chrono::time_point<std::chrono::steady_clock> now = frames[i].time;
+            for(int guard = 0; guard < 8 && fsm.nextDeadline(now, deadline) && deadline <= now; ++guard) {
+                fsm.resetOrProcess(now);
+            }
+
+            std::vector<TouchEvent> & frame = touches[i];
+            if(frame.empty()) {
+                fsm.resetOrProcess(now);
+            } else if(frame.size() == 1) {
+                fsm.process(frame);
+            } else if(frame.size() <= 3) {
+                fsm.reset();
+            }
+        }
+        fsm.resetOrProcess(frames.back().time + std::chrono::seconds(2));
+        spent += std::chrono::steady_clock::now() - start;
+        allocs += allocations - before;
+
+        return std::make_pair(events, gestures);
+    });
+}
+
+//geometry kernels against the straightforward per-sample loops they replace
+
+constexpr std::size_t GEO_WINDOWS = 256;
+
+struct Windows {
+    std::vector<PointWindow> points;
+    std::size_t total = 0;
+};
+
+//noisy arcs of random radius, full 64 point windows
+static Windows geometryInput() {
+    Windows w;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> radius(50.f, 1500.f);
+    std::uniform_real_distribution<float> start(-3.f, 3.f);
+    std::normal_distribution<float> noise(0.f, 1.5f);
+    w.points.resize(GEO_WINDOWS);
+    for(PointWindow & p : w.points) {
+        float r = radius(rng);
+        float a = start(rng);
+        p.size = GEOMETRY_WINDOW;
+        for(std::size_t i = 0; i < p.size; ++i) {
+            p.x[i] = 2000.f + r * std::cos(a + i * 15.f / r) + noise(rng);
+            p.y[i] = 2000.f + r * std::sin(a + i * 15.f / r) + noise(rng);
+        }
+        w.total += p.size;
+    }
+    return w;
+}
+
+static float naivePathLength(const PointWindow & p) {
+    float length = 0.f;
+    for(std::size_t i = 1; i < p.size; ++i) {
+        length += std::sqrt(std::pow(p.x[i] - p.x[i - 1], 2) + std::pow(p.y[i] - p.y[i - 1], 2));
+    }
+    return length;
+}
+
+static LineFit naiveFitLine(const PointWindow & p) {
+    LineFit fit = {};
+    for(std::size_t i = 0; i < p.size; ++i) {
+        fit.cx += p.x[i];
+        fit.cy += p.y[i];
+    }
+    fit.cx /= p.size;
+    fit.cy /= p.size;
+    float uu = 0.f, vv = 0.f, uv = 0.f;
+    for(std::size_t i = 0; i < p.size; ++i) {
+        uu += (p.x[i] - fit.cx) * (p.x[i] - fit.cx);
+        vv += (p.y[i] - fit.cy) * (p.y[i] - fit.cy);
+        uv += (p.x[i] - fit.cx) * (p.y[i] - fit.cy);
+    }
+    fit.angle = 0.5f * std::atan2(2.f * uv, uu - vv);
+    //residual point by point, like pointToLineDistance()
+    float nx = -std::sin(fit.angle);
+    float ny = std::cos(fit.angle);
+    float sq = 0.f;
+    for(std::size_t i = 0; i < p.size; ++i) {
+        float d = (p.x[i] - fit.cx) * nx + (p.y[i] - fit.cy) * ny;
+        sq += d * d;
+    }
+    fit.rms = std::sqrt(sq / p.size);
+    return fit;
+}
+
+static CircleFit naiveFitCircle(const PointWindow & p) {
+    CircleFit fit = {};
+    double mx = 0, my = 0;
+    for(std::size_t i = 0; i < p.size; ++i) {
+        mx += p.x[i];
+        my += p.y[i];
+    }
+    mx /= p.size;
+    my /= p.size;
+    double suu = 0, svv = 0, suv = 0, bu = 0, bv = 0;
+    for(std::size_t i = 0; i < p.size; ++i) {
+        double u = p.x[i] - mx;
+        double v = p.y[i] - my;
+        suu += u * u;
+        svv += v * v;
+        suv += u * v;
+        bu += 0.5 * (u * u * u + u * v * v);
+        bv += 0.5 * (v * v * v + v * u * u);
+    }
+    double det = suu * svv - suv * suv;
+    if(det == 0) return fit;
+    double uc = (bu * svv - bv * suv) / det;
+    double vc = (suu * bv - suv * bu) / det;
+    fit.cx = uc + mx;
+    fit.cy = vc + my;
+    fit.radius = std::sqrt(uc * uc + vc * vc + (suu + svv) / p.size);
+    fit.valid = true;
+    double sq = 0;
+    for(std::size_t i = 0; i < p.size; ++i) {
+        double d = std::hypot(p.x[i] - fit.cx, p.y[i] - fit.cy) - fit.radius;
+        sq += d * d;
+    }
+    fit.rms = std::sqrt(sq / p.size);
+    return fit;
+}
+
+//keeps results alive so nothing is optimized away
+static volatile float geometrySink;
+
+template<typename Kernel>
+static Result benchGeometry(const std::string & suite, const std::string & name, const Windows & input, int minMs, Kernel kernel) {
+    return measure(suite, name, minMs, [&](std::chrono::steady_clock::duration & spent, std::uint64_t & allocs) {
+        std::uint64_t before = allocations;
+        float sink = 0.f;
+        auto start = std::chrono::steady_clock::now();
+        for(const PointWindow & p : input.points) {
+            sink += kernel(p);
+        }
+        spent += std::chrono::steady_clock::now() - start;
+        allocs += allocations - before;
+        geometrySink = sink;
+        return std::make_pair(static_cast<std::uint64_t>(input.total), std::uint64_t(0));
+    });
+}
+
+static void benchGeometry(std::vector<Result> & results, const std::string & filter, int minMs) {
+    Windows input = geometryInput();
+    std::string simd = std::string("simd-") + geometryIsa();
+    auto wanted = [&filter](const char * name) { return filter.empty() || std::string(name).find(filter) != std::string::npos; };
+    float out[GEOMETRY_WINDOW];
+
+    if(wanted("distances")) {
+        results.push_back(benchGeometry("scalar", "distances", input, minMs, [&out](const PointWindow & p) {
+            for(std::size_t i = 0; i < p.size; ++i) {
+                out[i] = std::sqrt(std::pow(p.x[i] - 2000.f, 2) + std::pow(p.y[i] - 2000.f, 2));
+            }
+            return out[p.size - 1];
+        }));
+        results.push_back(benchGeometry(simd, "distances", input, minMs, [&out](const PointWindow & p) {
+            distances(p, 2000.f, 2000.f, out);
+            return out[p.size - 1];
+        }));
+    }
+    if(wanted("angles")) {
+        results.push_back(benchGeometry("scalar", "angles", input, minMs, [&out](const PointWindow & p) {
+            for(std::size_t i = 0; i + 1 < p.size; ++i) {
+                out[i] = std::atan2(p.y[i + 1] - p.y[i], p.x[i + 1] - p.x[i]);
+            }
+            return out[p.size - 2];
+        }));
+        results.push_back(benchGeometry(simd, "angles", input, minMs, [&out](const PointWindow & p) {
+            segmentAngles(p, out);
+            return out[p.size - 2];
+        }));
+    }
+    if(wanted("path")) {
+        results.push_back(benchGeometry("scalar", "path", input, minMs, naivePathLength));
+        results.push_back(benchGeometry(simd, "path", input, minMs, [](const PointWindow & p) { return pathLength(p); }));
+    }
+    if(wanted("linefit")) {
+        results.push_back(benchGeometry("scalar", "linefit", input, minMs, [](const PointWindow & p) { return naiveFitLine(p).rms; }));
+        results.push_back(benchGeometry(simd, "linefit", input, minMs, [](const PointWindow & p) { return fitLine(p).rms; }));
+    }
+    if(wanted("circlefit")) {
+        results.push_back(benchGeometry("scalar", "circlefit", input, minMs, [](const PointWindow & p) { return naiveFitCircle(p).rms; }));
+        results.push_back(benchGeometry(simd, "circlefit", input, minMs, [](const PointWindow & p) { return fitCircle(p).rms; }));
+    }
+}
+
+//steady state driver and FSM never touch the heap
+static bool checkAllocations(const std::vector<Result> & results) {
+    bool ok = true;
+    for(const Result & r : results) {
+        if((r.suite == "driver" || r.suite == "fsm") && r.allocsPerEvent > 0) {
+            std::cerr << "FAIL " << r.suite << " " << r.scenario << ": " << r.allocsPerEvent << " allocations/event" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//whole script through GestureRecognizer on its own thread, fast replay unless realtime; types of delivered gestures.
+//delay slows the callback (recognition) down
+static std::vector<Gestures> recognize(const Script & script, const std::function<void(GestureRecognizer &)> & setup,
+                                        std::chrono::microseconds delay = std::chrono::microseconds(0), bool realtime = false) {
+    std::vector<Gestures> types;
+    GestureRecognizer recognizer;
+    if(!recognizer.initReplayBuffer(script.data().data(), script.data().size(), realtime)) return types;
+    setup(recognizer);
+    std::atomic<std::size_t> count{0};
+    recognizer.onGesture([&](const Gesture & g) {
+        types.push_back(g.type);
+        count.store(types.size(), std::memory_order_relaxed);
+        if(delay.count()) std::this_thread::sleep_for(delay);
+    });
+    recognizer.start();
+
+    //all frames read, then until gestures stop coming
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(recognizer.stats().driver.frames < script.frames() && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    //a slow callback must not look like the end
+    auto quiet = std::max<std::chrono::microseconds>(std::chrono::milliseconds(200), delay * 2);
+    std::size_t seen = 0;
+    do {
+        seen = count.load(std::memory_order_relaxed);
+        std::this_thread::sleep_for(quiet);
+    } while(seen != count.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < until);
+    recognizer.shutdown();
+    return types;
+}
+
+static std::size_t countOf(const std::vector<Gestures> & types, Gestures type) {
+    return std::count(types.begin(), types.end(), type);
+}
+
+//frames drained in one go are ticked on their own time, not the time drain started
+static bool checkDrainedTaps() {
+    std::vector<Gestures> types = recognize(taps(3), [](GestureRecognizer & r) { r.drainFrames(true); });
+    if(countOf(types, Gestures::Tap) != 3 || countOf(types, Gestures::Hold) != 0) {
+        std::cerr << "FAIL drained taps: " << countOf(types, Gestures::Tap) << " taps, "
+                  << countOf(types, Gestures::Hold) << " holds out of 3 taps" << std::endl;
+        return false;
+    }
+
+    //nor on the time they got read: realtime, slow TouchDown callback leaves the whole second tap to one late drain
+    Script s;
+    doubleTap(s, 2000, 2000);
+    s.wait(400);
+    types = recognize(s, [](GestureRecognizer & r) { r.drainFrames(true); }, std::chrono::milliseconds(350), true);
+    if(countOf(types, Gestures::DoubleTap) != 1 || countOf(types, Gestures::Tap) != 0) {
+        std::cerr << "FAIL drained double tap: " << countOf(types, Gestures::DoubleTap) << " double taps, "
+                  << countOf(types, Gestures::Tap) << " taps out of 1 double tap" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//pipelined recognition stage still in TouchDown callback when the reader already passed tap timeout:
+//the timeout is due as soon as End is handled, not skipped
+static bool checkLateTap() {
+    std::vector<Gestures> types = recognize(taps(1), [](GestureRecognizer & r) { r.pipelined(true); },
+                                            std::chrono::milliseconds(400));
+    if(countOf(types, Gestures::Tap) != 1 || countOf(types, Gestures::TouchUp) != 1) {
+        std::cerr << "FAIL late tap: " << countOf(types, Gestures::Tap) << " taps, "
+                  << countOf(types, Gestures::TouchUp) << " TouchUp out of 1 tap" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//pipelined recognition stage far behind the reader: frame queue overflows, still every TouchDown gets its TouchUp.
+//Realtime at 1kHz, so the blocked reader reads frames late; they must keep their own time or the tap timeout
+//runs out between the two taps of a double tap
+static bool checkSaturatedFrames() {
+    constexpr int STROKES = 3;
+    Script s(1000);
+    for(int i = 0; i < STROKES; ++i) {
+        int x = 500;
+        int y = 500 + i * 1000;
+        still(s, 0, x, y, 8);
+        for(int f = 0; f < 500; ++f) {
+            x += 6;
+            s.touch(0, x, y);
+            s.frame();
+        }
+        s.lift(0);
+        s.frame();
+        s.wait(120);
+        doubleTap(s, x, y);
+        s.wait(400);
+    }
+
+    std::vector<Gestures> types = recognize(s, [](GestureRecognizer & r) { r.pipelined(true); },
+                                            std::chrono::milliseconds(3), true);
+    std::size_t downs = countOf(types, Gestures::TouchDown);
+    std::size_t ups = countOf(types, Gestures::TouchUp);
+    std::size_t doubleTaps = countOf(types, Gestures::DoubleTap);
+    if(downs != 2 * STROKES || ups != 2 * STROKES || doubleTaps != STROKES) {
+        std::cerr << "FAIL saturated frame queue: " << downs << " TouchDown, " << ups << " TouchUp, "
+                  << doubleTaps << " DoubleTap out of " << STROKES << " swipes and double taps" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//gesture queue consumer racing a producer that keeps overwriting: every item taken is whole and in order,
+//and taken + dropped accounts for everything pushed
+static bool checkRingOverwrite() {
+    struct Item {
+        std::uint64_t seq;
+        std::uint64_t check[7];
+    };
+    constexpr std::uint64_t ITEMS = 1000000;
+    SpscRing<Item> ring(64);
+    std::atomic<bool> done{false};
+
+    std::thread producer([&]() {
+        for(std::uint64_t i = 0; i < ITEMS; ++i) {
+            Item item;
+            item.seq = i;
+            std::fill(std::begin(item.check), std::end(item.check), ~i);
+            ring.push(item, true);
+            if(i % 4 == 3) ring.publish();
+        }
+        ring.publish();
+        done.store(true, std::memory_order_release);
+    });
+
+    std::uint64_t taken = 0;
+    std::uint64_t next = 0;
+    bool ok = true;
+    Item items[16];
+    while(true) {
+        bool last = done.load(std::memory_order_acquire);
+        std::size_t count = ring.pop(items, 16);
+        for(std::size_t i = 0; i < count; ++i) {
+            const Item & item = items[i];
+            if(item.seq < next || std::any_of(std::begin(item.check), std::end(item.check),
+                                                [&item](std::uint64_t c) { return c != ~item.seq; })) {
+                ok = false;
+            }
+            next = item.seq + 1;
+        }
+        taken += count;
+        if(last && count == 0) break;
+    }
+    producer.join();
+
+    if(!ok || taken + ring.dropped() != ITEMS) {
+        std::cerr << "FAIL ring overwrite: " << (ok ? "" : "torn or reordered items, ") << taken << " taken + "
+                  << ring.dropped() << " dropped of " << ITEMS << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printJson(const std::vector<Result> & results) {
+    std::cout << "[\n";
+    for(std::size_t i = 0; i < results.size(); ++i) {
+        const Result & r = results[i];
+        std::cout << "  {\"suite\": \"" << r.suite << "\", \"scenario\": \"" << r.scenario
+                  << "\", \"iterations\": " << r.iterations << ", \"events\": " << r.events
+                  << ", \"ns_per_event\": " << r.nsPerEvent << ", \"allocs_per_event\": " << r.allocsPerEvent
+                  << ", \"gestures_per_s\": " << r.gesturesPerSecond << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "]" << std::endl;
+}
+
+static void printTable(const std::vector<Result> & results) {
+    std::printf("%-11s %-10s %10s %10s %12s %14s\n", "suite", "scenario", "events", "ns/event", "allocs/event", "gestures/s");
+    for(const Result & r : results) {
+        std::printf("%-11s %-10s %10llu %10.1f %12.4f %14.0f\n", r.suite.c_str(), r.scenario.c_str(),
+                    static_cast<unsigned long long>(r.events), r.nsPerEvent, r.allocsPerEvent, r.gesturesPerSecond);
+    }
+}
+
+int main(int argc, char ** argv) {
+    bool json = false;
+    bool check = false;
+    int minMs = 300;
+    std::string filter;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--json") json = true;
+        else if(arg == "--min-ms" && i + 1 < argc) minMs = std::atoi(argv[++i]);
+        else if(arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if(arg == "--check") check = true;
+        else {
+            std::cerr << "usage: " << argv[0] << " [--json] [--min-ms N] [--filter text] [--check]" << std::endl;
+            return 1;
+        }
+    }
+
+    struct Scenario {
+        std::string name;
+        Script script;
+    };
+    std::vector<Scenario> scenarios = {
+        { "taps", taps() },
+        { "drags", drags() },
+        { "circles", circles() },
+        { "chaos", chaos() }
+    };
+
+    std::vector<Result> results;
+    for(const Scenario & s : scenarios) {
+        if(!filter.empty() && s.name.find(filter) == std::string::npos) continue;
+        results.push_back(benchDriver(s.name, s.script, minMs));
+        std::vector<Frame> frames = driverOutput(s.script);
+        if(!frames.empty()) results.push_back(benchFsm(s.name, frames, minMs));
+    }
+    benchGeometry(results, filter, minMs);
+
+    if(json) printJson(results);
+    else printTable(results);
+
+    bool ok = true;
+    if(check) {
+        ok = checkAllocations(results) && ok;
+        ok = checkRingOverwrite() && ok;
+        ok = checkDrainedTaps() && ok;
+        ok = checkLateTap() && ok;
+        ok = checkSaturatedFrames() && ok;
+        std::cerr << (ok ? "checks passed" : "checks FAILED") << std::endl;
+    }
+    return ok ? 0 : 1;
+}
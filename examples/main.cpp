@@ -5,6 +5,8 @@
 #include <fstream>
 #include <csignal>
 #include <thread>
+#include <vector>
+#include <poll.h>
 
 #include "gestlib/GestLib.h"
 
@@ -16,7 +18,7 @@ void signalHandler(int signum) {
     _running = false;
 }
 
-void processGestures(const std::vector<Gesture> & gestures);
+void processGestures(const Gesture * gestures, std::size_t count);
 
 int main() {
     signal(SIGINT, signalHandler);
@@ -33,12 +35,17 @@ int main() {
         return 2;
     }
 
-    int fps = 1 / 60.f * 1000;
+    //in a real app notifyFd() goes into the app's own poll/epoll/GLib/SDL loop
+    struct pollfd pfd = { .fd = recognizer.notifyFd(), .events = POLLIN, .revents = 0 };
+    std::vector<Gesture> gestures(64);
     while(_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(fps));
+        if(poll(&pfd, 1, 100) <= 0) continue;
 
-        std::vector<Gesture> gestures = recognizer.fetchGestures();
-        processGestures(gestures);
+        recognizer.clearNotification();
+        std::size_t count;
+        while((count = recognizer.fetchGestures(gestures.data(), gestures.size())) > 0) {
+            processGestures(gestures.data(), count);
+        }
     }
 
     recognizer.shutdown();
@@ -46,14 +53,16 @@ int main() {
 }
 
 
-void processGestures(const std::vector<Gesture> & gestures) {
-    if(gestures.empty()) return;
-    for(const Gesture &g : gestures) {
+void processGestures(const Gesture * gestures, std::size_t count) {
+    for(std::size_t i = 0; i < count; ++i) {
+        const Gesture & g = gestures[i];
         switch(g.type) {
             case(Gestures::TouchDown):
                 std::cout << "It's touch down event!" << 
                 " x: " << g.touchDown.x << 
-                " y: " << g.touchDown.y << std::endl;    
+                " y: " << g.touchDown.y << 
+                " latency: " << std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - g.time).count() << "us" << std::endl;    
             break;
             case(Gestures::TouchUp):
                 std::cout << "It's touch up event!" << std::endl;
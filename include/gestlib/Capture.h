@@ -0,0 +1,42 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <cstdint>
+
+namespace GestLib {
+
+//Capture file layout: one CaptureHeader, then CaptureRecord's until end of file.
+//Records are raw evdev events as driver decoded them (SYN_DROPPED included),
+//native endianness, so captures are meant to be replayed on the same architecture family.
+
+constexpr uint32_t CAPTURE_MAGIC = 0x50434c47; //"GLCP"
+constexpr uint16_t CAPTURE_VERSION = 1;
+
+struct CaptureAbs {
+    int32_t minimum;
+    int32_t maximum;
+    int32_t fuzz;
+    int32_t flat;
+    int32_t resolution;
+};
+
+struct CaptureHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slots;
+    CaptureAbs x;
+    CaptureAbs y;
+    char uniq[64];
+};
+
+struct CaptureRecord {
+    int64_t timeUs; //CLOCK_MONOTONIC, microseconds
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+};
+
+static_assert(sizeof(CaptureRecord) == 16, "CaptureRecord must stay 16 bytes");
+
+}
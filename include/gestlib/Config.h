@@ -0,0 +1,108 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GestLib {
+
+//Every timeout and threshold of recognition. Times are milliseconds, distances touchscreen units
+//except straightRms.
+//Defaults are what used to be hardcoded.
+struct RecognizerConfig {
+    //finger tracking (TouchDriver)
+    int probationTime = 50;         //new contact has this long...
+    int activationCount = 4;        //...to report more than this many times, otherwise it's noise
+    int activeToLost = 50;          //finger without reports is lost...
+    int lostTimeout = 50;           //...and ends if nothing picks it up again within this
+    int trackingBox = 30;           //contact this close (each axis) to a lost finger continues it
+    int moveMin = 2;                //smaller steps aren't reported as Move
+    int moveMax = 30;               //neither are larger ones, those are jumps
+
+    //one finger gestures (OneFingerFSM)
+    int tapTimeout = 300;
+    int dragOrHoldTimeout = 200;
+    int holdTimeout = 800;
+    int doubleTapTimeout = 200;
+    int dragOrHoldGrace = 20;       //DragOrHold without movement gives up after this
+    int swipeDistance = 10;         //from first touch
+    int dragDistance = 20;          //from first touch
+    int swipeStep = 5;              //Move of swipe needs more than this from previous event
+    int doubleTapSwipeStep = 2;     //at least this
+    int circularStep = 2;           //more than this
+    float circularTurn = 3.14159265f * 0.95f;   //radians turned over Trajectory::TURN_WINDOW segments that make a circle
+    float straightRms = 3.0f;       //...unless points are this close to a straight line, output pixels (windowSize())
+    int doubleTapPredictions = 3;   //same classification this many moves in a row decides double tap swipe/circular
+};
+
+//what driver and FSM use until they're given a config
+inline const RecognizerConfig DEFAULT_CONFIG{};
+
+//false (and why on stderr) for values recognition can't work with
+bool validConfig(const RecognizerConfig & config);
+//"key = value" lines named like RecognizerConfig fields, '#' comments; missing keys keep defaults.
+//False on unreadable file, unknown key or bad value
+bool loadConfig(const std::string & path, RecognizerConfig & config);
+
+//Current config behind an atomic pointer (RCU style). Writers copy the new config and swap the
+//pointer, readers pick it up with one atomic load and never wait for a writer. Old copies are freed
+//by later publishes once no reader announces them (one hazard slot per reader).
+class ConfigStore {
+    public:
+    static constexpr std::size_t READERS = 4;
+
+    //one per thread that reads config, slot unique among them
+    class Reader {
+        public:
+        //latest published config; a load and compare when nothing changed.
+        //Returned reference stays valid until next refresh() of this reader
+        const RecognizerConfig & refresh();
+
+        private:
+        friend class ConfigStore;
+        Reader(ConfigStore & store, std::size_t slot) : _store(store), _slot(slot) {}
+        ConfigStore & _store;
+        std::size_t _slot;
+        const RecognizerConfig * _config = nullptr;
+    };
+
+    ConfigStore();
+    ~ConfigStore();
+    ConfigStore(const ConfigStore &) = delete;
+    ConfigStore & operator=(const ConfigStore &) = delete;
+
+    Reader reader(std::size_t slot) { return Reader(*this, slot); }
+
+    //any thread; writers serialize among themselves only. False if config isn't valid
+    bool publish(const RecognizerConfig & config);
+    //copy of what was published last, any thread
+    RecognizerConfig latest() const;
+
+    //loads file now and again whenever it's rewritten or replaced (inotify on its directory, own thread).
+    //Reload that fails keeps previous config. False if file can't be loaded now
+    bool watch(const std::string & path);
+    void unwatch();
+
+    private:
+    std::atomic<const RecognizerConfig *> _current;
+    //what each reader uses right now
+    std::array<std::atomic<const RecognizerConfig *>, READERS> _hazards{};
+    mutable std::mutex _writer;
+    //replaced, possibly still in use
+    std::vector<const RecognizerConfig *> _retired;
+
+    std::thread _watcher;
+    int _inotifyFd = -1;
+    int _stopFd = -1;
+
+    void reclaim();
+    void watchLoop(std::string path);
+};
+
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace GestLib {
+
+//Compile-time transition tables. A recognizer lists its rules as types:
+//
+//  using Table = FsmEngine<Machine, State, STATES, &Machine::transition,
+//      Rule<Idle, FsmOn::Begin, Stroke, If<>, Do<&Machine::touchDown>>,
+//      Rule<Stroke, FsmOn::Tick, Idle, If<&Machine::ended, &Machine::tapTimeout>, Do<&Machine::tap>>,
+//      ...>;
+//  Table::dispatch(machine, state, FsmOn::Tick, args...);
+//
+//Guards and actions are member functions of Machine, all called with the same args.
+//Rules of the current state are tried in table order: the first whose input matches and whose
+//guards all pass runs its actions, then Machine::transition(To) is called. To may also be
+//FsmNext::Stay (done, no transition) or FsmNext::Continue (keep trying the following rules).
+//Everything is resolved at compile time, dispatch is one indexed call per state, no virtuals.
+
+namespace FsmOn {
+    constexpr unsigned Begin = 1;
+    constexpr unsigned Move = 2;
+    constexpr unsigned End = 4;
+    //no input, timers only
+    constexpr unsigned Tick = 8;
+    constexpr unsigned Touch = Begin | Move | End;
+}
+
+enum class FsmNext {
+    Stay,
+    Continue
+};
+
+template<auto... Guards>
+struct If {};
+
+template<auto... Actions>
+struct Do {};
+
+template<auto From, unsigned On, auto To, typename Guards = If<>, typename Actions = Do<>>
+struct Rule;
+
+template<auto From, unsigned On, auto To, auto... Guards, auto... Actions>
+struct Rule<From, On, To, If<Guards...>, Do<Actions...>> {
+    static constexpr auto from = From;
+    static constexpr unsigned on = On;
+    static constexpr auto to = To;
+
+    template<typename Machine, typename... Args>
+    static bool guard(Machine & machine, const Args &... args) {
+        return (true && ... && (machine.*Guards)(args...));
+    }
+
+    template<typename Machine, typename... Args>
+    static void act(Machine & machine, const Args &... args) {
+        ((machine.*Actions)(args...), ...);
+    }
+};
+
+template<typename Machine, typename State, std::size_t States, void (Machine::*Transition)(State), typename... Rules>
+class FsmEngine {
+    public:
+    //true if some rule fired
+    template<typename... Args>
+    static bool dispatch(Machine & machine, State state, unsigned input, const Args &... args) {
+        return table<Args...>[static_cast<std::size_t>(state)](machine, input, args...);
+    }
+
+    private:
+    template<typename... Args>
+    using Handler = bool (*)(Machine &, unsigned, const Args &...);
+
+    template<typename... Args, std::size_t... S>
+    static constexpr std::array<Handler<Args...>, States> handlers(std::index_sequence<S...>) {
+        return {{ &handle<S, Args...>... }};
+    }
+
+    //only rules of state S are compiled in
+    template<std::size_t S, typename... Args>
+    static bool handle(Machine & machine, unsigned input, const Args &... args) {
+        bool fired = false;
+        (void)(... || tryRule<S, Rules>(machine, input, fired, args...));
+        return fired;
+    }
+
+    //true stops the search
+    template<std::size_t S, typename R, typename... Args>
+    static bool tryRule(Machine & machine, unsigned input, bool & fired, const Args &... args) {
+        if constexpr(static_cast<std::size_t>(R::from) != S) {
+            return false;
+        } else {
+            if(!(R::on & input) || !R::guard(machine, args...)) return false;
+            R::act(machine, args...);
+            fired = true;
+            if constexpr(std::is_same<typename std::decay<decltype(R::to)>::type, FsmNext>::value) {
+                return R::to == FsmNext::Stay;
+            } else {
+                (machine.*Transition)(R::to);
+                return true;
+            }
+        }
+    }
+
+    //one handler per state
+    template<typename... Args>
+    static constexpr std::array<Handler<Args...>, States> table = handlers<Args...>(std::make_index_sequence<States>{});
+};
+
+}
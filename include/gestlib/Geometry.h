@@ -0,0 +1,73 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <array>
+#include <cstddef>
+
+namespace GestLib {
+
+//Batch geometry over a window of points, 4 lanes at a time: SSE2 on x86-64, NEON on AArch64,
+//plain loops elsewhere or with cmake -DGESTLIB_SIMD=OFF. Points are structure of arrays,
+//x and y in separate aligned arrays.
+
+constexpr std::size_t GEOMETRY_WINDOW = 64;
+
+struct PointWindow {
+    alignas(16) std::array<float, GEOMETRY_WINDOW> x;
+    alignas(16) std::array<float, GEOMETRY_WINDOW> y;
+    std::size_t size = 0;
+
+    //anything with operator[] giving .x/.y and static size(), e.g. RingHistory::Window<K> of TouchEvent's
+    template<typename Window>
+    void load(const Window & window) {
+        static_assert(Window::size() <= GEOMETRY_WINDOW, "window is larger than PointWindow");
+        for(std::size_t i = 0; i < Window::size(); ++i) {
+            x[i] = window[i].x;
+            y[i] = window[i].y;
+        }
+        size = Window::size();
+    }
+    void add(float px, float py) {
+        x[size] = px;
+        y[size] = py;
+        ++size;
+    }
+};
+
+struct LineFit {
+    float cx;       //centroid
+    float cy;
+    float angle;    //direction of the line, radians (-pi/2, pi/2]
+    float rms;      //root mean square distance of points from the line
+};
+
+struct CircleFit {
+    float cx;
+    float cy;
+    float radius;
+    float rms;      //root mean square of |distance to center - radius|
+    bool valid;     //false for (nearly) collinear points
+};
+
+//"sse2", "neon" or "scalar"
+const char * geometryIsa();
+
+//out[i] = |p[i] - c|, n outputs
+void distances(const float * x, const float * y, std::size_t n, float cx, float cy, float * out);
+//out[i] = direction of segment p[i] -> p[i + 1], n - 1 outputs (fastAtan2 precision)
+void segmentAngles(const float * x, const float * y, std::size_t n, float * out);
+//sum of segment lengths
+float pathLength(const float * x, const float * y, std::size_t n);
+//total least squares (orthogonal) line, n >= 2
+LineFit fitLine(const float * x, const float * y, std::size_t n);
+//algebraic (Kasa) circle fit, n >= 3
+CircleFit fitCircle(const float * x, const float * y, std::size_t n);
+
+inline void distances(const PointWindow & p, float cx, float cy, float * out) { distances(p.x.data(), p.y.data(), p.size, cx, cy, out); }
+inline void segmentAngles(const PointWindow & p, float * out) { segmentAngles(p.x.data(), p.y.data(), p.size, out); }
+inline float pathLength(const PointWindow & p) { return pathLength(p.x.data(), p.y.data(), p.size); }
+inline LineFit fitLine(const PointWindow & p) { return fitLine(p.x.data(), p.y.data(), p.size); }
+inline CircleFit fitCircle(const PointWindow & p) { return fitCircle(p.x.data(), p.y.data(), p.size); }
+
+}
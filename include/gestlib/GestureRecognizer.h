@@ -6,12 +6,20 @@
 #include "Gestures.h"
 #include "TouchDriver.h"
 #include "OneFingerFSM.h"
+#include "SpscRing.h"
+#include "Latency.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Config.h"
 
 #include <vector>
+#include <string>
 #include <atomic>
-#include <mutex>
 #include <thread>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <array>
 
 namespace GestLib {
 
@@ -21,26 +29,174 @@ class GestureRecognizer {
     ~GestureRecognizer();
 
     bool init();
+    //fake driver: replays capture made with startCapture(), realtime or as fast as possible
+    bool initReplay(const std::string & capture, bool realtime = true);
+    //capture already in memory, e.g. generated; buffer must outlive the recognizer
+    bool initReplayBuffer(const void * data, std::size_t size, bool realtime = false);
     void windowSize(int x, int y) { _ofs.expectedResolution(x, y); }
+    //call before init()
+    void ioEngine(IoEngine engine) { _dri.ioEngine(engine); }
+    void deviceCache(const std::string & path) { _dri.deviceCache(path); }
+    //process all queued frames on every wakeup instead of one
+    void drainFrames(bool drain) { _drainFrames = drain; }
+    //two threads: reader stage drains input and tracks fingers, recognition stage runs FSM,
+    //frames go between them through lock free queue. Call before start(); realtime() applies to both
+    void pipelined(bool pipelined) { _pipelined = pipelined; }
+    //call before start(); BusyPoll is meant for an isolated core, pin it with realtime()
+    void waitMode(WaitMode mode) { _waitMode = mode; }
+    //call before start(); applied by the recognizer thread(s) when they start, outcome is logged
+    void realtime(const RealtimeConfig & config) { _realtime = config; }
+    //timeouts and thresholds (Config.h); any thread, any time, recognition switches over on its next frame
+    //without ever waiting for a lock. False if config isn't valid
+    bool config(const RecognizerConfig & config) { return _config.publish(config); }
+    RecognizerConfig config() const { return _config.latest(); }
+    //load config from file and reload it on every change (own thread), false if it can't be loaded now
+    bool configFile(const std::string & path) { return _config.watch(path); }
+    //applies realtime() config to the calling thread and reports what took effect,
+    //start() does it itself - call it from your loop thread in pump() mode
+    RealtimeStatus applyRealtime();
     bool start();
     bool shutdown();
 
+    //threadless mode: don't start(), drive recognition from your own loop after init().
+    //Wait for fd() readable or pumpTimeout() ms elapsed, then pump() on the same thread.
+    //With onGesture() set gestures are delivered from inside pump(), nothing is locked or queued.
+    void pump(std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now());
+    //touchscreen (or replay) fd, -1 while device is unplugged; re-register it when handleHotplug() returns true
+    //or when it changed over a pump() (device lost and found again in one go)
+    int fd() const { return _dri.fd(); }
+    //inotify on /dev/input, -1 for replay; call handleHotplug() when readable
+    int hotplugFd() const { return _dri.hotplugFd(); }
+    bool handleHotplug();
+    //ms until next FSM/driver deadline, 0 to pump again right away, -1 to wait for input only
+    int pumpTimeout();
+
+    //record raw input into a file for initReplay(), between init() and start()
+    bool startCapture(const std::string & path) { return _dri.startCapture(path); }
+
+    //gesture queue, call before start(); capacity is rounded up to power of two
+    void queueCapacity(std::size_t capacity) { _queue.resize(capacity); }
+    void overflowPolicy(OverflowPolicy policy) { _overflow = policy; }
+
+    //consumer side, lock free; single consumer thread only
+    std::size_t fetchGestures(Gesture * out, std::size_t max);
+    bool tryPop(Gesture & out);
     std::vector<Gesture> fetchGestures();
 
+    //eventfd, readable when new gestures were published; valid after init().
+    //On POLLIN call clearNotification() and then fetch until empty.
+    int notifyFd() const { return _notifyFd; }
+    void clearNotification();
+    //lowest latency: gestures go straight to callback on recognizer thread, queue and notifyFd are unused.
+    //Callback must be quick, input isn't read while it runs. Set before start().
+    void onGesture(std::function<void(const Gesture &)> callback) { _callback = std::move(callback); }
+    //gestures lost (or merged away) because consumer didn't keep up
+    std::uint64_t droppedGestures() const { return _queue.dropped() + _coalesced.load(std::memory_order_relaxed); }
+    //per gesture type and stage latency histograms (see Latency.h), call before start().
+    //Costs a few clock reads per frame and gesture, off by default
+    void measureLatency(bool measure);
+    //empty summary / nullptr unless measuring; safe from any thread while running
+    LatencySummary latency(Gestures type, LatencyStage stage) const;
+    const LatencyHistogram * latencyHistogram(Gestures type, LatencyStage stage) const;
+    void resetLatency();
+
+    //binary trace of FSM states, timers and gestures kept in memory (Trace.h).
+    //Capacity in records, rounded up to power of two, 0 turns it off; call before start()
+    void trace(std::size_t capacity);
+    //on demand: binary into fd or readable text; fine from any thread while running
+    bool dumpTrace(int fd) const { return _trace.dump(fd); }
+    void dumpTrace(std::ostream & out) const { _trace.dump(out); }
+    //after trace(): write binary dump to path if process crashes
+    bool dumpTraceOnCrash(const std::string & path);
+
+    //counters of driver, FSM and queues; cheap, any thread, any time
+    RecognizerStats stats() const;
+
+    //kernel queue overflows (SYN_DROPPED) seen by driver; pipelined reader stage waits for recognition stage instead of dropping
+    std::uint64_t droppedFrames() const { return _dri.droppedCount() + _frames.dropped(); }
+
     private:
     TouchDriver _dri;
     OneFingerFSM _ofs;
 
-    std::mutex _lock;
+    ConfigStore _config;
+    //driver runs on reader stage, FSM on recognition stage (same thread unless pipelined)
+    ConfigStore::Reader _driverConfig = _config.reader(0);
+    ConfigStore::Reader _fsmConfig = _config.reader(1);
+
     std::thread _recognizer;
+    //recognition stage in pipelined mode, _recognizer is the reader then
+    std::thread _recognition;
 
     std::atomic<bool> _running;
-    std::vector<Gesture> _gesturesQueue;
+    bool _drainFrames;
+    bool _pipelined;
+    WaitMode _waitMode;
+
+    SpscRing<Gesture> _queue;
+    OverflowPolicy _overflow;
+    //CoalesceMoves: Move held back while queue is full
+    bool _hasPendingMove;
+    Gesture _pendingMove;
+    std::atomic<std::uint64_t> _coalesced;
+    std::array<std::atomic<std::uint64_t>, GESTURE_TYPES> _gestureCounts{};
+
+    int _notifyFd = -1;
+    //fd already signalled and not yet cleared by consumer, saves a write() per frame
+    std::atomic<bool> _notified;
+    std::function<void(const Gesture &)> _callback;
+    //driver output of current frame, reused so steady state doesn't allocate
+    std::vector<TouchEvent> _touches;
+
+    RealtimeConfig _realtime;
+
+    //pipelined mode: reader -> recognition stage
+    SpscRing<TouchFrame> _frames{1};
+    int _frameFd = -1;
+    std::atomic<bool> _framesSignalled;
+    //recognition stage's copy of a frame, reused
+    std::vector<TouchEvent> _stageTouches;
+    //FSM deadlines of recognition stage, _timerFd only serves driver then
+    int _stageTimerFd = -1;
+
+    //GESTURE_TYPES x LATENCY_STAGES, null when not measuring
+    std::unique_ptr<LatencyHistogram[]> _latency;
+    //stamps of the frame being dispatched; false for timeouts, their gestures skip Read/Driver/Push
+    bool _frameStamped = false;
+    std::chrono::time_point<std::chrono::steady_clock> _frameKernel;
+    std::chrono::time_point<std::chrono::steady_clock> _frameReadAt;
+    std::chrono::time_point<std::chrono::steady_clock> _frameOutAt;
+
+    TraceRing _trace;
+    int _crashFd = -1;
 
-    std::chrono::time_point<std::chrono::steady_clock> _lastAction;
     int _efd = -1;
+    //armed for the earliest driver/FSM deadline, nothing wakes the thread otherwise
+    int _timerFd = -1;
 
-    void pushGesture(Gesture gest);
+    bool initRecognition();
+    bool iterate(std::chrono::time_point<std::chrono::steady_clock> now);
+    bool nextDeadline(std::chrono::time_point<std::chrono::steady_clock> now,
+                        std::chrono::time_point<std::chrono::steady_clock> & deadline,
+                        bool driver = true, bool fsm = true);
+    void armDeadline(int timerFd, bool driver, bool fsm);
+    bool startPipeline();
+    bool readStage();
+    void pushFrame(const std::vector<TouchEvent> & touches, std::chrono::time_point<std::chrono::steady_clock> readAt);
+    bool waitFrameRoom();
+    void signalFrames();
+    void recognitionLoop();
+    void catchUp(std::chrono::time_point<std::chrono::steady_clock> from,
+                    std::chrono::time_point<std::chrono::steady_clock> to);
+    void dispatch(std::vector<TouchEvent> & touches, std::chrono::time_point<std::chrono::steady_clock> now);
+    std::chrono::time_point<std::chrono::steady_clock> latencyNow() const;
+    void stampFrame(const std::vector<TouchEvent> & touches, std::chrono::time_point<std::chrono::steady_clock> readAt);
+    LatencyHistogram & histogram(Gestures type, LatencyStage stage) const;
+    void recordPush(Gesture & gest);
+    void traceGesture(const Gesture & g);
+    void recordFetch(const Gesture * gestures, std::size_t count);
+    void pushGesture(Gesture gest, std::chrono::time_point<std::chrono::steady_clock> time);
+    void publishGestures();
     friend class OneFingerFSM;
 };
 
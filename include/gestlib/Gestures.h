@@ -3,6 +3,7 @@
 
 #pragma once
 #include <variant>
+#include <chrono>
 
 namespace GestLib {
 
@@ -28,6 +29,8 @@ enum class Gestures {
     ThreeFingerSwipe
 };
 
+constexpr int GESTURE_TYPES = static_cast<int>(Gestures::ThreeFingerSwipe) + 1;
+
 enum class GestureState {
     Start,
     Move,
@@ -100,6 +103,10 @@ struct TouchUpEvent {
 
 struct Gesture {
     Gestures type;
+    //kernel timestamp (CLOCK_MONOTONIC == steady_clock) of the input that produced this gesture
+    std::chrono::time_point<std::chrono::steady_clock> time;
+    //when recognizer queued it, only set with measureLatency()
+    std::chrono::time_point<std::chrono::steady_clock> pushed;
     union {
         TouchDownEvent touchDown;
         TouchUpEvent touchUp;
@@ -0,0 +1,63 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace GestLib {
+
+enum class LatencyStage {
+    Read,       //kernel timestamp -> recognizer started reading the frame
+    Driver,     //read -> finger tracking produced touches
+    Push,       //touches -> FSM pushed the gesture
+    Fetch,      //pushed -> consumer fetched it (or callback got it)
+    Total       //kernel timestamp of causing input -> consumer, includes FSM timers (Tap waits for them)
+};
+
+constexpr int LATENCY_STAGES = static_cast<int>(LatencyStage::Total) + 1;
+
+struct LatencySummary {
+    std::uint64_t count;
+    std::chrono::nanoseconds min;
+    std::chrono::nanoseconds p50;
+    std::chrono::nanoseconds p90;
+    std::chrono::nanoseconds p99;
+    std::chrono::nanoseconds p999;
+    std::chrono::nanoseconds max;
+};
+
+//HDR style log-linear histogram of nanoseconds: exact below 16, then 16 buckets per power
+//of two (~6% resolution) up to 2^36 ns (~68s), anything longer lands in the last bucket.
+//record() is a relaxed atomic increment, reading from other threads while it runs is fine.
+class LatencyHistogram {
+    public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int MAX_BITS = 36;
+    static constexpr int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    void record(std::chrono::nanoseconds value);
+    //not atomic as a whole, records running meanwhile may survive
+    void reset();
+
+    std::uint64_t count() const;
+    //upper bound of the bucket holding q-th fraction of values, q in [0, 1]
+    std::chrono::nanoseconds percentile(double q) const;
+    LatencySummary summary() const;
+
+    //raw buckets, e.g. for exporting
+    std::uint64_t bucketCount(int bucket) const { return _counts[bucket].load(std::memory_order_relaxed); }
+    static int bucketOf(std::uint64_t ns);
+    //lowest value landing in bucket
+    static std::uint64_t bucketFloor(int bucket);
+
+    private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> _counts{};
+    std::atomic<std::uint64_t> _min{UINT64_MAX};
+    std::atomic<std::uint64_t> _max{0};
+};
+
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <iostream>
+
+//Messages above GESTLIB_LOG_LEVEL are compiled out, arguments aren't even evaluated.
+//Release (NDEBUG) keeps errors and warnings, debug builds add GESTLIB_DEBUG;
+//GESTLIB_TRACE is for hot path and has to be asked for explicitly (-DGESTLIB_LOG_LEVEL=5).
+#define GESTLIB_LEVEL_NONE 0
+#define GESTLIB_LEVEL_ERROR 1
+#define GESTLIB_LEVEL_WARN 2
+#define GESTLIB_LEVEL_INFO 3
+#define GESTLIB_LEVEL_DEBUG 4
+#define GESTLIB_LEVEL_TRACE 5
+
+#ifndef GESTLIB_LOG_LEVEL
+#ifdef NDEBUG
+#define GESTLIB_LOG_LEVEL GESTLIB_LEVEL_WARN
+#else
+#define GESTLIB_LOG_LEVEL GESTLIB_LEVEL_DEBUG
+#endif
+#endif
+
+//no std::endl: stderr is unbuffered anyway, no need for extra flush
+#define GESTLIB_LOG(level, msg) do { \
+        if constexpr((level) <= GESTLIB_LOG_LEVEL) { std::cerr << msg << '\n'; } \
+    } while(0)
+
+#define GESTLIB_ERROR(msg) GESTLIB_LOG(GESTLIB_LEVEL_ERROR, msg)
+#define GESTLIB_WARN(msg) GESTLIB_LOG(GESTLIB_LEVEL_WARN, msg)
+#define GESTLIB_INFO(msg) GESTLIB_LOG(GESTLIB_LEVEL_INFO, msg)
+#define GESTLIB_DEBUG(msg) GESTLIB_LOG(GESTLIB_LEVEL_DEBUG, msg)
+#define GESTLIB_TRACE(msg) GESTLIB_LOG(GESTLIB_LEVEL_TRACE, msg)
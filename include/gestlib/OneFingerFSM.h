@@ -3,9 +3,16 @@
 
 #pragma once
 #include "defines.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Trajectory.h"
+#include "RingHistory.h"
+#include "Gestures.h"
+#include "Config.h"
 #include <vector>
-#include <deque>
 #include <chrono>
+#include <array>
+#include <atomic>
 
 namespace GestLib {
 
@@ -16,18 +23,17 @@ class OneFingerFSM {
 
     bool init(int resX, int resY);
     void expectedResolution(int x, int y);
+    //timeouts and distances, has to stay valid until replaced; GestureRecognizer hands over its current one every frame
+    void config(const RecognizerConfig & config) { _config = &config; }
 
     void process(std::vector<TouchEvent> & touches);
-    int resetOrProcess(/*std::vector<TouchEvent> & touches*/);
+    //no new input, just timers; now must be steady_clock (same as TouchEvent::time)
+    int resetOrProcess(std::chrono::time_point<std::chrono::steady_clock> now);
+    //when resetOrProcess() should be called next, false if nothing is pending
+    bool nextDeadline(std::chrono::time_point<std::chrono::steady_clock> now,
+                        std::chrono::time_point<std::chrono::steady_clock> & deadline);
     void reset();
 
-    private:
-
-    int _resolutionX;
-    int _resolutionY;
-    int _expectedX;
-    int _expectedY;
-
     enum state {
         Idle,
         Stroke,
@@ -40,7 +46,23 @@ class OneFingerFSM {
         Hold,
         HoldOngoing
     };
+    static_assert(HoldOngoing + 1 == FSM_STATES, "Stats.h keeps a counter per state");
+    static const char * stateName(state state);
+    //entries into each state so far, safe from any thread
+    std::array<std::uint64_t, FSM_STATES> transitions() const;
+    //records states and timers there, nullptr to stop
+    void trace(TraceRing * ring) { _trace = ring; }
+
+    private:
+
+    int _resolutionX;
+    int _resolutionY;
+    int _expectedX;
+    int _expectedY;
+
     state _state = Idle;
+    const RecognizerConfig * _config = &DEFAULT_CONFIG;
+    std::array<std::atomic<std::uint64_t>, FSM_STATES> _transitions{};
     TouchEvent _lastEvent;
     TouchEvent _startEvent;
 
@@ -52,29 +74,88 @@ class OneFingerFSM {
     
     gestureMove _doubleTapHelper;
     int _predictions;
-    std::deque<TouchEvent> _eventsHistory;
+    //second touch of a double tap, from its Begin on
+    Trajectory _trajectory;
+    //last events of any type, oldest are overwritten
+    RingHistory<TouchEvent, 64> _eventsHistory;
 
     struct timer {
         using timePoint = std::chrono::time_point<std::chrono::steady_clock>;
+        explicit timer(TraceTimer id) : _id(id) {}
+        TraceTimer id() const { return _id; }
         void start(int timeout, timePoint & now);
         void stop();
         bool active() { return _active; }
         bool expired(timePoint & now);
+        timePoint deadline() const;
 
         private:
-        int _timeout;
-        bool _active;
+        TraceTimer _id;
+        int _timeout = 0;
+        bool _active = false;
         timePoint _startTime;
     };
 
-    timer _tapTimer;
-    timer _doubleTapTimer;
-    timer _dragOrHoldTimer;
-    timer _holdTimer;
+    timer _tapTimer{TraceTimer::Tap};
+    timer _doubleTapTimer{TraceTimer::DoubleTap};
+    timer _dragOrHoldTimer{TraceTimer::DragOrHold};
+    timer _holdTimer{TraceTimer::Hold};
 
     GestureRecognizer & _recognizer;
+    TraceRing * _trace = nullptr;
 
-    void printState(state state);
+    void setState(state state);
+    void startTimer(timer & t, int timeout, timer::timePoint & now);
+    //active and expired
+    bool timerExpired(timer & t, timer::timePoint & now);
+
+    //transition table (FsmEngine.h) is in OneFingerFSM.cpp, below is what it's made of.
+    //For Tick the event is _lastEvent and now is the tick time, otherwise the event itself and its time.
+    struct Rules;
+    using timePoint = timer::timePoint;
+    //entering Idle is reset()
+    void transition(state to);
+
+    //guards
+    bool sameFinger(const TouchEvent & event, timePoint now);
+    bool otherFinger(const TouchEvent & event, timePoint now);
+    bool lastFinger(const TouchEvent & event, timePoint now);
+    bool notLastFinger(const TouchEvent & event, timePoint now);
+    bool begun(const TouchEvent & event, timePoint now);
+    bool ended(const TouchEvent & event, timePoint now);
+    bool afterMove(const TouchEvent & event, timePoint now);
+    bool notAfterMove(const TouchEvent & event, timePoint now);
+    bool graceOver(const TouchEvent & event, timePoint now);
+    template<timer OneFingerFSM::*T>
+    bool expired(const TouchEvent & event, timePoint now);
+    template<int RecognizerConfig::*Distance>
+    bool fromStartAtLeast(const TouchEvent & event, timePoint now);
+    template<int RecognizerConfig::*Distance>
+    bool fromLastAtLeast(const TouchEvent & event, timePoint now);
+    template<int RecognizerConfig::*Distance>
+    bool fromLastOver(const TouchEvent & event, timePoint now);
+    template<gestureMove Move>
+    bool decided(const TouchEvent & event, timePoint now);
+
+    //actions
+    enum class At {
+        Event,
+        Start,
+        Last
+    };
+    template<Gestures Type, GestureState State = GestureState::Start, At Where = At::Event, bool Delta = false>
+    void emit(const TouchEvent & event, timePoint now);
+    template<timer OneFingerFSM::*T, int RecognizerConfig::*Timeout>
+    void arm(const TouchEvent & event, timePoint now);
+    template<timer OneFingerFSM::*T>
+    void disarm(const TouchEvent & event, timePoint now);
+    void remember(const TouchEvent & event, timePoint now);
+    //only logs
+    void strayFinger(const TouchEvent & event, timePoint now);
+    void trackSecond(const TouchEvent & event, timePoint now);
+    void track(const TouchEvent & event, timePoint now);
+    void vote(const TouchEvent & event, timePoint now);
+    void circularMove(const TouchEvent & event, timePoint now);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+
+//USDT probes for perf/bpftrace, provider "gestlib". Built only with cmake -DGESTLIB_USDT=ON
+//(needs sys/sdt.h, systemtap-sdt-dev); otherwise they are nothing. A disabled probe is a nop instruction.
+//
+//  gestlib:frame        frame time ns (CLOCK_MONOTONIC), input_events decoded so far
+//  gestlib:syn_dropped  overflows so far
+//  gestlib:finger       logical id, state (0 Probation, 1 Active, 2 Lost, -1 removed), x, y
+//  gestlib:fsm_state    previous OneFingerFSM::state, new state
+//  gestlib:push         Gestures type, GestureState or -1, x, y
+//  gestlib:fetch        gestures fetched, still queued
+//
+//  e.g. bpftrace -e 'usdt:./example:gestlib:push { @[arg0] = count(); }'
+
+#ifdef GESTLIB_USDT
+#include <sys/sdt.h>
+#define GESTLIB_PROBE(...) STAP_PROBEV(gestlib, __VA_ARGS__)
+#else
+#define GESTLIB_PROBE(...) do {} while(0)
+#endif
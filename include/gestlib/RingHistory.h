@@ -0,0 +1,59 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <array>
+#include <cstddef>
+
+namespace GestLib {
+
+//Last N items of a stream in one contiguous array. N is a power of two, so indexing is a mask;
+//push() overwrites the oldest item once full and nothing is ever allocated.
+template<typename T, std::size_t N>
+class RingHistory {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "RingHistory size must be a power of two");
+    static constexpr std::size_t MASK = N - 1;
+
+    public:
+    //K newest items, oldest first. K is a compile-time constant, loops over a window have fixed trip count
+    template<std::size_t K>
+    class Window {
+        public:
+        static constexpr std::size_t size() { return K; }
+        const T & operator[](std::size_t i) const { return _items[(_start + i) & MASK]; }
+
+        private:
+        friend class RingHistory;
+        Window(const T * items, std::size_t start) : _items(items), _start(start) {}
+        const T * _items;
+        std::size_t _start;
+    };
+
+    static constexpr std::size_t capacity() { return N; }
+
+    void push(const T & item) {
+        _items[_count & MASK] = item;
+        ++_count;
+    }
+    void clear() { _count = 0; }
+
+    std::size_t size() const { return _count < N ? _count : N; }
+    bool empty() const { return _count == 0; }
+    //0 is the oldest item still kept
+    const T & operator[](std::size_t i) const { return _items[(_count - size() + i) & MASK]; }
+    //0 is the newest item
+    const T & back(std::size_t i = 0) const { return _items[(_count - 1 - i) & MASK]; }
+
+    //only when size() >= K
+    template<std::size_t K>
+    Window<K> last() const {
+        static_assert(K <= N, "window is larger than history");
+        return Window<K>(_items.data(), _count - K);
+    }
+
+    private:
+    std::array<T, N> _items{};
+    std::size_t _count = 0;
+};
+
+}
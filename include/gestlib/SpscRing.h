@@ -0,0 +1,154 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace GestLib {
+
+//Bounded single-producer/single-consumer ring.
+//Producer push()es into a staging area and makes the whole batch visible with publish().
+//When full, producer may overwrite the oldest item. _head stays consumer's own: it skips what was
+//overwritten and counts it as dropped. Every slot is a seqlock over atomic words, so a copy the
+//producer overwrites meanwhile is detected (and dropped) instead of being a data race.
+template<typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing copies items word by word");
+
+    public:
+    explicit SpscRing(std::size_t capacity = 256) { resize(capacity); }
+
+    //not thread safe, only before producer/consumer start
+    void resize(std::size_t capacity) {
+        std::size_t size = 1;
+        while(size < capacity) size <<= 1;
+        _slots.reset(new Slot[size]);
+        _mask = size - 1;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _staged = 0;
+        _dropped.store(0, std::memory_order_relaxed);
+        _highWater.store(0, std::memory_order_relaxed);
+    }
+
+    //producer side
+    bool full() const { return _staged - _head.load(std::memory_order_acquire) > _mask; }
+
+    //false if full and dropOldest is not allowed (item is lost then)
+    bool push(const T & item, bool dropOldest) {
+        if(full() && !dropOldest) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        //full: this overwrites the oldest item, consumer notices by its sequence
+        write(_staged, item);
+        ++_staged;
+        return true;
+    }
+
+    //returns how many items became visible
+    std::size_t publish() {
+        std::size_t published = _staged - _tail.load(std::memory_order_relaxed);
+        _tail.store(_staged, std::memory_order_release);
+
+        std::size_t depth = _staged - _head.load(std::memory_order_relaxed);
+        if(depth > capacity()) depth = capacity();
+        if(depth > _highWater.load(std::memory_order_relaxed)) {
+            _highWater.store(depth, std::memory_order_relaxed);
+        }
+        return published;
+    }
+
+    //consumer side
+    bool tryPop(T & out) {
+        return pop(&out, 1) == 1;
+    }
+
+    std::size_t pop(T * out, std::size_t max) {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+        //producer went round over what wasn't taken in time
+        if(tail - head > capacity()) {
+            _dropped.fetch_add(tail - head - capacity(), std::memory_order_relaxed);
+            head = tail - capacity();
+        }
+
+        std::size_t count = 0;
+        while(count < max && head != tail) {
+            if(read(head, out[count])) {
+                ++count;
+            } else {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            ++head;
+        }
+        _head.store(head, std::memory_order_release);
+        return count;
+    }
+
+    std::size_t size() const {
+        std::size_t size = _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+        return size > capacity() ? capacity() : size;
+    }
+    std::size_t capacity() const { return _mask + 1; }
+    //memory items live in, for mlock()
+    const void * storage() const { return _slots.get(); }
+    std::size_t storageSize() const { return capacity() * sizeof(Slot); }
+    std::uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    //deepest the queue got when producer published
+    std::size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+    private:
+    static constexpr std::size_t WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    struct Slot {
+        //2 * position + 1 while written, 2 * position + 2 once it holds that position's item
+        std::atomic<std::size_t> seq{0};
+        std::atomic<std::uint64_t> words[WORDS];
+    };
+
+    void write(std::size_t position, const T & item) {
+        Slot & slot = _slots[position & _mask];
+        std::uint64_t raw[WORDS] = {};
+        std::memcpy(raw, &item, sizeof(T));
+        slot.seq.store(2 * position + 1, std::memory_order_relaxed);
+        //release: reader that sees any new word sees odd seq too
+        for(std::size_t i = 0; i < WORDS; ++i) {
+            slot.words[i].store(raw[i], std::memory_order_release);
+        }
+        slot.seq.store(2 * position + 2, std::memory_order_release);
+    }
+
+    //false when the slot doesn't hold this position anymore, or got overwritten while copying
+    bool read(std::size_t position, T & out) const {
+        const Slot & slot = _slots[position & _mask];
+        std::size_t seq = slot.seq.load(std::memory_order_acquire);
+        if(seq != 2 * position + 2) return false;
+        std::uint64_t raw[WORDS];
+        //acquire keeps the seq check below after the copy
+        for(std::size_t i = 0; i < WORDS; ++i) {
+            raw[i] = slot.words[i].load(std::memory_order_acquire);
+        }
+        if(slot.seq.load(std::memory_order_relaxed) != seq) return false;
+        std::memcpy(&out, raw, sizeof(T));
+        return true;
+    }
+
+    //consumer position, only consumer moves it
+    alignas(64) std::atomic<std::size_t> _head{0};
+    //published producer position
+    alignas(64) std::atomic<std::size_t> _tail{0};
+    //producer only
+    alignas(64) std::size_t _staged = 0;
+    std::atomic<std::uint64_t> _dropped{0};
+    std::atomic<std::size_t> _highWater{0};
+    std::size_t _mask = 0;
+    std::unique_ptr<Slot[]> _slots;
+};
+
+}
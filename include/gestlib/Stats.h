@@ -0,0 +1,44 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include "Gestures.h"
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+namespace GestLib {
+
+//every counter has exactly one writing thread: plain load + store is enough and
+//avoids locked read-modify-write on hot path, other threads read them relaxed
+inline void bump(std::atomic<std::uint64_t> & counter, std::uint64_t by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+struct DriverStats {
+    std::uint64_t frames;           //complete SYN_REPORT frames
+    std::uint64_t events;           //input_events decoded
+    std::uint64_t syscalls;         //read()/ioctl() on the device by Batched engine and replay; not Libevdev's own reads
+    std::uint64_t libevdevCalls;    //libevdev_next_event() calls of Libevdev engine, most served from libevdev's buffer
+    std::uint64_t synDropped;       //kernel queue overflows
+    std::uint64_t fingersCreated;   //logical fingers, start in Probation
+    std::uint64_t fingersPromoted;  //Probation -> Active, FSM got Begin
+    std::uint64_t fingersDiscarded; //dropped in Probation, FSM never saw them
+    std::uint64_t contactsDropped;  //new contact left untracked for a frame, all logical fingers taken (retried next frame)
+};
+
+//OneFingerFSM::state count
+constexpr int FSM_STATES = 10;
+
+struct RecognizerStats {
+    DriverStats driver;
+    std::array<std::uint64_t, FSM_STATES> transitions;  //entries into each OneFingerFSM::state
+    std::array<std::uint64_t, GESTURE_TYPES> gestures;  //pushed per Gestures type
+    std::uint64_t queueHighWater;       //deepest gesture queue seen by producer
+    std::uint64_t queueDropped;         //lost or coalesced gestures, same as droppedGestures()
+    std::uint64_t frameQueueHighWater;  //pipelined mode only
+    std::uint64_t frameQueueDropped;
+};
+
+}
@@ -7,9 +7,15 @@
 #include <vector>
 #include <deque>
 #include <chrono>
+#include <atomic>
+#include <cstdint>
 
 #include <fstream>
+#include <linux/input.h>
 #include "defines.h"
+#include "Capture.h"
+#include "Stats.h"
+#include "Config.h"
 
 class libevdev;
 
@@ -21,26 +27,122 @@ class TouchDriver {
     ~TouchDriver();
 
     bool init();
+    //file remembering where the touchscreen was, lets warm start skip the scan; call before init()
+    void deviceCache(const std::string & path) { _cachePath = path; }
+    //feed a capture file instead of a device; realtime keeps recorded timing,
+    //otherwise frames go out as fast as they're read (driver clock follows the capture)
+    bool initReplay(const std::string & path, bool realtime = true);
+    //same from capture already in memory (header + records), buffer must outlive the driver
+    bool initReplayBuffer(const void * data, std::size_t size, bool realtime = false);
     bool shutdown();
     void printCapabilities();
 
-    std::vector<TouchEvent> getEvents();
+    //write raw stream into capture file (see Capture.h), call after init() and before reading starts
+    bool startCapture(const std::string & path);
+    void stopCapture();
+
+    DriverType type() const { return _type; }
+    //steady_clock, except fast replay where time is taken from the capture
+    std::chrono::time_point<std::chrono::steady_clock> now() const;
+    //when tick() should run next for finger timeouts, false if nothing is pending
+    bool nextDeadline(std::chrono::time_point<std::chrono::steady_clock> now,
+                        std::chrono::time_point<std::chrono::steady_clock> & deadline) const;
+
+    //must be set before init()
+    void ioEngine(IoEngine engine) { _engine = engine; }
+    //tracking thresholds, has to stay valid until replaced; GestureRecognizer hands over its current one every frame
+    void config(const RecognizerConfig & config) { _config = &config; }
+    //mlock() read buffer, finger tables and mapped capture; after init(). False (errno set) if any of it failed
+    bool lockMemory();
+    //true when already read events are waiting in userspace buffer (Batched engine)
+    bool pending() const { return _evHead < _evTail; }
+
+    //all of these overwrite events, keep the same vector around and they won't allocate
+    //true when new input was read
+    bool getEvents(std::vector<TouchEvent> & events);
+    //reads and processes exactly one complete frame, false if none is ready
+    bool getFrame(std::vector<TouchEvent> & events);
+    //when the frame last read was completed (kernel timestamp), what its events are timed with
+    std::chrono::time_point<std::chrono::steady_clock> frameTime() const { return _frameTime; }
+    //only finger timeouts, no reading
+    void tick(std::vector<TouchEvent> & events) { process(false, events); }
 
     const std::string & uniq() const { return _uniq; }
     const std::string & path() const { return _path; }
-    const int resolutionX() const { return _resX; }
-    const int resolutionY() const { return _resY; }   
-
-    int fd() const { return _fd; } //ugh... don't like this move
+    int resolutionX() const { return _resX; }
+    int resolutionY() const { return _resY; }
+
+    int fd() const { return _fd; } //ugh... don't like this move, -1 while device is unplugged
+    //inotify on /dev/input, -1 for fake driver
+    int hotplugFd() const { return _inotifyFd; }
+    //call when hotplugFd() is readable, true when lost device was attached again (fd() changed)
+    bool handleHotplug();
+    //one look for the lost device without waiting for inotify, e.g. right after read path lost it; same result
+    bool reattach();
+    //how many times kernel queue overflowed (SYN_DROPPED) since start
+    std::uint64_t droppedCount() const { return _droppedCount.load(std::memory_order_relaxed); }
+    //safe from any thread
+    DriverStats stats() const;
 
     private:
 
     //maximal possible simultanious finger touches
     int _maxFingers;
+    const RecognizerConfig * _config = &DEFAULT_CONFIG;
 
     //touchscreen things
     int _fd;
     libevdev * _dev;
+    IoEngine _engine;
+    DriverType _type;
+    //absinfo and uniq of the device, header for captures
+    CaptureHeader _info;
+
+    std::ofstream _capture;
+    bool _capturing;
+
+    //replay, _fd is a timerfd (realtime) or an eventfd that is kept readable (fast)
+    const unsigned char * _replayMap;
+    std::size_t _replaySize;
+    //mmap'ed by us, not caller's buffer
+    bool _replayOwned;
+    const CaptureRecord * _replayCur;
+    const CaptureRecord * _replayEnd;
+    bool _replayRealtime;
+    bool _replayStarted;
+    std::chrono::steady_clock::duration _replayOffset;
+    //now() may be asked from recognition stage of pipelined mode
+    std::atomic<std::chrono::time_point<std::chrono::steady_clock>> _virtualNow;
+    std::atomic<std::chrono::time_point<std::chrono::steady_clock>> _replayEofAt;
+    std::atomic<bool> _replayEof;
+
+    //hot-plug, identity of the device to look for when it comes back
+    int _inotifyFd;
+    int _vendor;
+    int _product;
+    std::string _cachePath;
+
+    //Batched engine read buffer, [_evHead, _evTail) is not yet decoded
+    std::vector<input_event> _evBuf;
+    std::size_t _evHead;
+    std::size_t _evTail;
+    bool _skipToReport;
+    //device timestamps are CLOCK_MONOTONIC (EVIOCSCLOCKID succeeded)
+    bool _kernelClock;
+    //next process() has to diff logical fingers against resynced _raw
+    bool _resync;
+    std::atomic<std::uint64_t> _droppedCount;
+    //written by reading thread only, see bump()
+    std::atomic<std::uint64_t> _framesRead{0};
+    std::atomic<std::uint64_t> _eventsRead{0};
+    std::atomic<std::uint64_t> _syscalls{0};
+    std::atomic<std::uint64_t> _libevdevCalls{0};
+    std::atomic<std::uint64_t> _fingersCreated{0};
+    std::atomic<std::uint64_t> _fingersPromoted{0};
+    std::atomic<std::uint64_t> _fingersDiscarded{0};
+    std::atomic<std::uint64_t> _contactsDropped{0};
+    //EVIOCGMTSLOTS buffer, code + one value per device slot
+    std::vector<int32_t> _slotQuery;
 
     std::string _uniq;
     std::string _path;
@@ -59,6 +161,8 @@ class TouchDriver {
 
     int _currentSlot;
     std::vector<RawFinger> _raw;
+    //when last complete frame (SYN_REPORT) was seen
+    std::chrono::time_point<std::chrono::steady_clock> _frameTime;
 
     enum class FingerState {
         Probation,
@@ -78,16 +182,41 @@ class TouchDriver {
         int activeCount;
         bool updatedThisFrame;
         bool markToDelete;
+        bool used = false;
         std::chrono::time_point<std::chrono::steady_clock> lastAction;
     };
 
+    //raw slot -> index in _logicalFingers of the finger it fed last time, -1 if none
+    std::vector<int> _slotFinger;
+    //fixed size table, entries are reused (used == false) instead of erased
     std::vector<LogicalFinger> _logicalFingers;
-    std::vector<RawFinger> _currentFrameFingers;
     int _internalIdCounter;
 
+    bool scanDevices(bool sameDevice);
+    bool scanDevNodes(bool sameDevice);
+    bool tryOpen(const std::string & path, bool sameDevice);
+    bool sysfsIsMultitouch(const std::string & sysDevice);
+    bool sysfsSameIdentity(const std::string & sysDevice);
+    bool loadDeviceCache();
+    void saveDeviceCache();
+    void attach(int fd, libevdev * dev, const std::string & path);
+    void detach();
     bool readData();
-    std::vector<TouchEvent> process(bool newData);
-    void probablyMove(LogicalFinger & finger, std::vector<TouchEvent> & ret);
+    bool readLibevdev();
+    bool readBatched();
+    bool startReplay(const void * data, std::size_t size, const std::string & name, bool realtime);
+    bool readReplay();
+    void finishReplay();
+    void record(const input_event & ev);
+    void writeRecord(const CaptureRecord & rec);
+    void armReplayTimer(std::chrono::time_point<std::chrono::steady_clock> at);
+    void recordState();
+    bool decodeEvent(const input_event & ev);
+    bool resyncFromKernel();
+    void reconcile(std::vector<TouchEvent> & ret, std::chrono::time_point<std::chrono::steady_clock> now);
+    void applyEventMask();
+    void process(bool newData, std::vector<TouchEvent> & ret);
+    void probablyMove(LogicalFinger & finger, std::vector<TouchEvent> & ret, std::chrono::time_point<std::chrono::steady_clock> now);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace GestLib {
+
+//Binary trace dump layout: one TraceHeader, then `count` TraceRecord's oldest first,
+//native endianness like captures (Capture.h).
+
+constexpr uint32_t TRACE_MAGIC = 0x52544c47; //"GLTR"
+constexpr uint16_t TRACE_VERSION = 1;
+
+enum class TraceKind : uint16_t {
+    State,          //code: new OneFingerFSM::state, value: previous one
+    TimerStart,     //code: TraceTimer, value: timeout in ms
+    TimerExpire,    //code: TraceTimer
+    Gesture         //code: Gestures, value: GestureState or -1, x/y: position
+};
+
+enum class TraceTimer : uint16_t {
+    Tap,
+    DoubleTap,
+    DragOrHold,
+    Hold
+};
+
+struct TraceRecord {
+    int64_t timeNs; //steady_clock
+    uint16_t kind;
+    uint16_t code;
+    int32_t value;
+    int32_t x;
+    int32_t y;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must stay 24 bytes");
+
+struct TraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t count;
+    uint64_t total; //records ever written, total - count were overwritten
+};
+
+//Preallocated ring of the last N records, written by recognition thread only.
+//Dump may run concurrently (other thread, signal handler), records being written
+//at that moment can come out torn - it's post-mortem data, not a log.
+class TraceRing {
+    public:
+    //rounded up to power of two, 0 frees everything; not while recording
+    void resize(std::size_t capacity);
+    bool enabled() const { return _mask != 0; }
+
+    void record(TraceKind kind, uint16_t code, int32_t value = 0, int32_t x = 0, int32_t y = 0) {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        TraceRecord & rec = _records[head & _mask];
+        rec.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        rec.kind = static_cast<uint16_t>(kind);
+        rec.code = code;
+        rec.value = value;
+        rec.x = x;
+        rec.y = y;
+        _head.store(head + 1, std::memory_order_release);
+    }
+
+    //binary, only write() - safe inside signal handler
+    bool dump(int fd) const;
+    //human readable, on demand
+    void dump(std::ostream & out) const;
+
+    private:
+    std::vector<TraceRecord> _records;
+    std::size_t _mask = 0;
+    std::atomic<std::size_t> _head{0};
+};
+
+//dump `ring` into `fd` when process dies on SIGSEGV/SIGBUS/SIGILL/SIGFPE/SIGABRT, then hand the signal
+//to the handler installed before (or its default action). One ring per process, nullptr puts previous handlers back
+bool dumpTraceOnCrash(const TraceRing * ring, int fd);
+
+}
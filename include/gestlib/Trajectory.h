@@ -0,0 +1,142 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace GestLib {
+
+constexpr float PI = 3.14159265f;
+
+//atan2 through a 7th order polynomial on [0, 1], max error ~2.5e-4 rad (0.015 deg)
+inline float fastAtan2(float y, float x) {
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float hi = ax > ay ? ax : ay;
+    float lo = ax > ay ? ay : ax;
+    if(hi == 0.f) return 0.f;
+
+    float a = lo / hi;
+    float s = a * a;
+    float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+    if(ay > ax) r = PI / 2 - r;
+    if(x < 0.f) r = PI - r;
+    return y < 0.f ? -r : r;
+}
+
+//Running geometry of one stroke, every add() is O(1): turn angle summed over the last
+//TURN_WINDOW segments, centroid, polar angle/radius around a fixed center and angular velocity.
+//No history is kept besides the turn window.
+class Trajectory {
+    public:
+    using timePoint = std::chrono::time_point<std::chrono::steady_clock>;
+    static constexpr std::size_t TURN_WINDOW = 10;
+
+    void reset(float cx, float cy) {
+        _cx = cx;
+        _cy = cy;
+        _points = 0;
+        _turns = 0;
+        _turnSum = 0.0;
+        _sumX = _sumY = _sumRadius = 0.0;
+        _rotation = _deltaAngle = _angularVelocity = 0.f;
+    }
+
+    void add(float x, float y, timePoint time) {
+        float rx = x - _cx;
+        float ry = y - _cy;
+        float angle = fastAtan2(ry, rx);
+        _radius = std::sqrt(rx * rx + ry * ry);
+
+        if(_points > 0) {
+            float dx = x - _x;
+            float dy = y - _y;
+            //zero length segment has no direction, keep the previous one
+            if(dx != 0.f || dy != 0.f) {
+                if(_hasSegment) {
+                    //|atan2(cross, dot)| is the angle between segments, no sqrt/acos needed
+                    addTurn(std::fabs(fastAtan2(_dx * dy - _dy * dx, _dx * dx + _dy * dy)));
+                }
+                _dx = dx;
+                _dy = dy;
+                _hasSegment = true;
+            }
+
+            _deltaAngle = angle - _angle;
+            if(_deltaAngle > PI) _deltaAngle -= 2 * PI;
+            if(_deltaAngle < -PI) _deltaAngle += 2 * PI;
+            _rotation += _deltaAngle;
+
+            float dt = std::chrono::duration<float>(time - _time).count();
+            _angularVelocity = dt > 0.f ? _deltaAngle / dt : 0.f;
+        } else {
+            _hasSegment = false;
+        }
+
+        _x = x;
+        _y = y;
+        _angle = angle;
+        _time = time;
+        _sumX += x;
+        _sumY += y;
+        _sumRadius += _radius;
+        ++_points;
+    }
+
+    std::size_t points() const { return _points; }
+    //turnSum() covers a whole window
+    bool windowFull() const { return _turns >= TURN_WINDOW; }
+    //sum of |turn| between consecutive segments in the window, radians
+    float turnSum() const { return static_cast<float>(_turnSum); }
+
+    float centroidX() const { return _points ? static_cast<float>(_sumX / _points) : _cx; }
+    float centroidY() const { return _points ? static_cast<float>(_sumY / _points) : _cy; }
+    //all around the center given to reset()
+    float angle() const { return _angle; }
+    float deltaAngle() const { return _deltaAngle; }
+    float rotation() const { return _rotation; }
+    float radius() const { return _radius; }
+    float meanRadius() const { return _points ? static_cast<float>(_sumRadius / _points) : 0.f; }
+    //rad/s over the last step
+    float angularVelocity() const { return _angularVelocity; }
+
+    private:
+    float _cx = 0.f;
+    float _cy = 0.f;
+
+    float _x = 0.f;
+    float _y = 0.f;
+    float _dx = 0.f;
+    float _dy = 0.f;
+    bool _hasSegment = false;
+    timePoint _time;
+    std::size_t _points = 0;
+
+    std::array<float, TURN_WINDOW> _window{};
+    std::size_t _turns = 0;
+    //double: it's added to and subtracted from forever
+    double _turnSum = 0.0;
+
+    double _sumX = 0.0;
+    double _sumY = 0.0;
+    double _sumRadius = 0.0;
+
+    float _angle = 0.f;
+    float _radius = 0.f;
+    float _deltaAngle = 0.f;
+    float _rotation = 0.f;
+    float _angularVelocity = 0.f;
+
+    void addTurn(float turn) {
+        float & slot = _window[_turns % TURN_WINDOW];
+        if(_turns >= TURN_WINDOW) _turnSum -= slot;
+        slot = turn;
+        _turnSum += turn;
+        ++_turns;
+    }
+};
+
+}
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <chrono>
+#include <vector>
 namespace GestLib {
 
 struct TouchEvent {
@@ -28,14 +29,6 @@ struct TouchEvent {
                 return false;
             }
     }
-    TouchEvent & operator=(const TouchEvent & other) {
-        id = other.id;
-        x = other.x;
-        y = other.y;
-        type = other.type;
-        // time = other.time;
-        return *this;
-    }
 };
 
 enum class DriverType {
@@ -43,6 +36,56 @@ enum class DriverType {
     Fake
 };
 
+enum class OverflowPolicy {
+    DropOldest,     //full gesture queue loses its oldest entry
+    CoalesceMoves   //Move's are merged while queue is full, only Start/End/Tap's push old ones out
+};
+
+enum class IoEngine {
+    Libevdev,   //one libevdev_next_event() call per input_event
+    Batched     //raw read() of many input_events per syscall, own MT slot decoding
+};
+
+enum class SchedPolicy {
+    Other,      //default time sharing, nothing changed
+    Fifo,       //SCHED_FIFO, needs CAP_SYS_NICE or RLIMIT_RTPRIO
+    RoundRobin  //SCHED_RR, same permissions
+};
+
+struct RealtimeConfig {
+    std::vector<int> cpus;                      //cores recognizer thread(s) may run on, empty leaves affinity alone
+    SchedPolicy policy = SchedPolicy::Other;
+    int priority = 0;                           //1..99 for Fifo/RoundRobin
+    bool lockMemory = false;                    //mlock() recognizer's own buffers and prefault stack, no page faults while
+                                                //recognizing; rest of the process is left alone (that's mlockall())
+};
+
+//what RealtimeConfig actually achieved
+struct RealtimeStatus {
+    bool pinned = false;
+    bool scheduled = false;
+    int priority = 0;       //may be lower than asked when RLIMIT_RTPRIO caps it
+    bool memoryLocked = false;
+};
+
+enum class WaitMode {
+    Poll,       //recognizer thread sleeps in poll() until input or next deadline
+    BusyPoll    //spins on non blocking fd with pause/yield backoff, burns a whole core
+};
+
+//driver output of one frame as pipelined mode queues it between stages.
+//Fixed size so it can go through lock free ring; more fingers than that are never one finger gesture anyway
+constexpr int FRAME_TOUCHES = 10;
+
+struct TouchFrame {
+    std::chrono::time_point<std::chrono::steady_clock> time; //when reader stage handed it over
+    int count;                                                //real number of touches, may exceed FRAME_TOUCHES
+    //latency stamps (steady_clock) of reading it and of driver output, only with measureLatency()
+    std::chrono::time_point<std::chrono::steady_clock> readAt;
+    std::chrono::time_point<std::chrono::steady_clock> outAt;
+    TouchEvent touches[FRAME_TOUCHES];
+};
+
 struct Vec2i {
     int x;
     int y;
@@ -0,0 +1,241 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#include "gestlib/Config.h"
+#include "gestlib/Log.h"
+
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace GestLib {
+
+namespace {
+
+struct ConfigField {
+    const char * name;
+    int RecognizerConfig::* i;
+    float RecognizerConfig::* f;
+};
+
+const ConfigField CONFIG_FIELDS[] = {
+    {"probationTime", &RecognizerConfig::probationTime, nullptr},
+    {"activationCount", &RecognizerConfig::activationCount, nullptr},
+    {"activeToLost", &RecognizerConfig::activeToLost, nullptr},
+    {"lostTimeout", &RecognizerConfig::lostTimeout, nullptr},
+    {"trackingBox", &RecognizerConfig::trackingBox, nullptr},
+    {"moveMin", &RecognizerConfig::moveMin, nullptr},
+    {"moveMax", &RecognizerConfig::moveMax, nullptr},
+    {"tapTimeout", &RecognizerConfig::tapTimeout, nullptr},
+    {"dragOrHoldTimeout", &RecognizerConfig::dragOrHoldTimeout, nullptr},
+    {"holdTimeout", &RecognizerConfig::holdTimeout, nullptr},
+    {"doubleTapTimeout", &RecognizerConfig::doubleTapTimeout, nullptr},
+    {"dragOrHoldGrace", &RecognizerConfig::dragOrHoldGrace, nullptr},
+    {"swipeDistance", &RecognizerConfig::swipeDistance, nullptr},
+    {"dragDistance", &RecognizerConfig::dragDistance, nullptr},
+    {"swipeStep", &RecognizerConfig::swipeStep, nullptr},
+    {"doubleTapSwipeStep", &RecognizerConfig::doubleTapSwipeStep, nullptr},
+    {"circularStep", &RecognizerConfig::circularStep, nullptr},
+    {"circularTurn", nullptr, &RecognizerConfig::circularTurn},
+    {"straightRms", nullptr, &RecognizerConfig::straightRms},
+    {"doubleTapPredictions", &RecognizerConfig::doubleTapPredictions, nullptr},
+};
+
+std::string trim(const std::string & s) {
+    std::size_t begin = s.find_first_not_of(" \t\r");
+    if(begin == std::string::npos) return std::string();
+    std::size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+}
+
+bool validConfig(const RecognizerConfig & config) {
+    for(const ConfigField & field : CONFIG_FIELDS) {
+        bool negative = field.i ? config.*field.i < 0 : config.*field.f < 0.f;
+        if(negative) {
+            GESTLIB_ERROR("config: " << field.name << " can't be negative");
+            return false;
+        }
+    }
+    //zero timers would fire right away
+    if(config.tapTimeout == 0 || config.dragOrHoldTimeout == 0 || config.holdTimeout == 0 ||
+        config.doubleTapTimeout == 0) {
+        GESTLIB_ERROR("config: timeouts must be positive");
+        return false;
+    }
+    if(config.moveMin > config.moveMax) {
+        GESTLIB_ERROR("config: moveMin is above moveMax");
+        return false;
+    }
+    return true;
+}
+
+bool loadConfig(const std::string & path, RecognizerConfig & config) {
+    std::ifstream in(path);
+    if(!in) {
+        GESTLIB_ERROR("config: can't open " << path);
+        return false;
+    }
+
+    RecognizerConfig loaded;
+    std::string line;
+    int lineNo = 0;
+    while(std::getline(in, line)) {
+        ++lineNo;
+        line = trim(line.substr(0, line.find('#')));
+        if(line.empty()) continue;
+
+        std::size_t eq = line.find('=');
+        std::string key = trim(line.substr(0, eq));
+        auto field = std::find_if(std::begin(CONFIG_FIELDS), std::end(CONFIG_FIELDS),
+                                    [&key](const ConfigField & f) { return key == f.name; });
+        if(eq == std::string::npos || field == std::end(CONFIG_FIELDS)) {
+            GESTLIB_ERROR("config: " << path << ":" << lineNo << ": unknown setting '" << key << "'");
+            return false;
+        }
+
+        std::istringstream value(line.substr(eq + 1));
+        if(field->i) value >> loaded.*field->i;
+        else value >> loaded.*field->f;
+        if(value.fail() || !(value >> std::ws).eof()) {
+            GESTLIB_ERROR("config: " << path << ":" << lineNo << ": bad value of " << key);
+            return false;
+        }
+    }
+
+    if(!validConfig(loaded)) return false;
+    config = loaded;
+    return true;
+}
+
+const RecognizerConfig & ConfigStore::Reader::refresh() {
+    const RecognizerConfig * latest = _store._current.load(std::memory_order_acquire);
+    if(latest != _config) {
+        //announce before use and check it's still current: publish() frees only what nobody announced
+        do {
+            _config = latest;
+            _store._hazards[_slot].store(latest, std::memory_order_seq_cst);
+            latest = _store._current.load(std::memory_order_seq_cst);
+        } while(latest != _config);
+    }
+    return *_config;
+}
+
+ConfigStore::ConfigStore() : _current(new RecognizerConfig()) {}
+
+ConfigStore::~ConfigStore() {
+    unwatch();
+    delete _current.load();
+    for(const RecognizerConfig * old : _retired) delete old;
+}
+
+bool ConfigStore::publish(const RecognizerConfig & config) {
+    if(!validConfig(config)) return false;
+
+    std::lock_guard<std::mutex> lock(_writer);
+    const RecognizerConfig * old = _current.exchange(new RecognizerConfig(config), std::memory_order_seq_cst);
+    _retired.push_back(old);
+    reclaim();
+    return true;
+}
+
+RecognizerConfig ConfigStore::latest() const {
+    //only writers free, and they hold the lock
+    std::lock_guard<std::mutex> lock(_writer);
+    return *_current.load(std::memory_order_relaxed);
+}
+
+//under _writer
+void ConfigStore::reclaim() {
+    auto inUse = [this](const RecognizerConfig * config) {
+        for(const auto & hazard : _hazards) {
+            if(hazard.load(std::memory_order_seq_cst) == config) return true;
+        }
+        return false;
+    };
+    _retired.erase(std::remove_if(_retired.begin(), _retired.end(), [&inUse](const RecognizerConfig * config) {
+        if(inUse(config)) return false;
+        delete config;
+        return true;
+    }), _retired.end());
+}
+
+bool ConfigStore::watch(const std::string & path) {
+    unwatch();
+
+    RecognizerConfig config;
+    if(!loadConfig(path, config) || !publish(config)) return false;
+
+    //editors often write a new file and rename it over the old one, so the directory is watched
+    std::size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_inotifyFd < 0 || _stopFd < 0 ||
+        inotify_add_watch(_inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        GESTLIB_WARN("config: can't watch " << dir << ": " << strerror(errno) << ", loaded once");
+        unwatch();
+        return true;
+    }
+
+    _watcher = std::thread(&ConfigStore::watchLoop, this, path);
+    return true;
+}
+
+void ConfigStore::unwatch() {
+    if(_watcher.joinable()) {
+        uint64_t u = 1;
+        write(_stopFd, &u, sizeof(u));
+        _watcher.join();
+    }
+    if(_inotifyFd >= 0) close(_inotifyFd);
+    _inotifyFd = -1;
+    if(_stopFd >= 0) close(_stopFd);
+    _stopFd = -1;
+}
+
+void ConfigStore::watchLoop(std::string path) {
+    std::size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    struct pollfd fds[2];
+    fds[0].fd = _inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _stopFd;
+    fds[1].events = POLLIN;
+
+    while(true) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR) continue;
+            GESTLIB_ERROR("config: poll failed: " << strerror(errno));
+            return;
+        }
+        if(fds[1].revents & POLLIN) return;
+
+        bool changed = false;
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t len;
+        while((len = read(_inotifyFd, buf, sizeof(buf))) > 0) {
+            for(char * ptr = buf; ptr < buf + len; ) {
+                const struct inotify_event * event = reinterpret_cast<const struct inotify_event*>(ptr);
+                if(event->len && name == event->name) changed = true;
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        RecognizerConfig config;
+        if(changed && loadConfig(path, config) && publish(config)) {
+            GESTLIB_INFO("config: reloaded " << path);
+        }
+    }
+}
+
+}
@@ -0,0 +1,321 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#include "gestlib/Geometry.h"
+#include "gestlib/Trajectory.h"
+
+#include <cmath>
+#include <cfloat>
+
+#if !defined(GESTLIB_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define GESTLIB_GEOMETRY_SSE2
+#elif !defined(GESTLIB_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GESTLIB_GEOMETRY_NEON
+#endif
+
+namespace GestLib {
+
+namespace {
+
+//Four float lanes, kernels below are written once against this.
+//Comparisons give a lane mask that only select() understands.
+#if defined(GESTLIB_GEOMETRY_SSE2)
+
+constexpr const char * ISA = "sse2";
+
+struct F4 {
+    __m128 v;
+    static F4 load(const float * p) { return {_mm_loadu_ps(p)}; }
+    static F4 set(float f) { return {_mm_set1_ps(f)}; }
+    void store(float * p) const { _mm_storeu_ps(p, v); }
+    float sum() const {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+inline F4 operator+(F4 a, F4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline F4 operator-(F4 a, F4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline F4 operator*(F4 a, F4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline F4 operator/(F4 a, F4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline F4 sqrt4(F4 a) { return {_mm_sqrt_ps(a.v)}; }
+inline F4 abs4(F4 a) { return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)}; }
+inline F4 min4(F4 a, F4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline F4 max4(F4 a, F4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline F4 less4(F4 a, F4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline F4 select4(F4 mask, F4 a, F4 b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+
+#elif defined(GESTLIB_GEOMETRY_NEON)
+
+constexpr const char * ISA = "neon";
+
+struct F4 {
+    float32x4_t v;
+    static F4 load(const float * p) { return {vld1q_f32(p)}; }
+    static F4 set(float f) { return {vdupq_n_f32(f)}; }
+    void store(float * p) const { vst1q_f32(p, v); }
+    float sum() const { return vaddvq_f32(v); }
+};
+
+inline F4 operator+(F4 a, F4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline F4 operator-(F4 a, F4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline F4 operator*(F4 a, F4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline F4 operator/(F4 a, F4 b) { return {vdivq_f32(a.v, b.v)}; }
+inline F4 sqrt4(F4 a) { return {vsqrtq_f32(a.v)}; }
+inline F4 abs4(F4 a) { return {vabsq_f32(a.v)}; }
+inline F4 min4(F4 a, F4 b) { return {vminq_f32(a.v, b.v)}; }
+inline F4 max4(F4 a, F4 b) { return {vmaxq_f32(a.v, b.v)}; }
+inline F4 less4(F4 a, F4 b) { return {vreinterpretq_f32_u32(vcltq_f32(a.v, b.v))}; }
+inline F4 select4(F4 mask, F4 a, F4 b) { return {vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)}; }
+
+#else
+
+constexpr const char * ISA = "scalar";
+
+//plain arrays, short fixed loops the compiler may still vectorize
+struct F4 {
+    float v[4];
+    static F4 load(const float * p) { return {{p[0], p[1], p[2], p[3]}}; }
+    static F4 set(float f) { return {{f, f, f, f}}; }
+    void store(float * p) const { for(int i = 0; i < 4; ++i) p[i] = v[i]; }
+    float sum() const { return (v[0] + v[2]) + (v[1] + v[3]); }
+};
+
+template<typename Op>
+inline F4 lanes(F4 a, F4 b, Op op) {
+    F4 r;
+    for(int i = 0; i < 4; ++i) r.v[i] = op(a.v[i], b.v[i]);
+    return r;
+}
+
+inline F4 operator+(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x + y; }); }
+inline F4 operator-(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x - y; }); }
+inline F4 operator*(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x * y; }); }
+inline F4 operator/(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x / y; }); }
+inline F4 sqrt4(F4 a) { return lanes(a, a, [](float x, float) { return std::sqrt(x); }); }
+inline F4 abs4(F4 a) { return lanes(a, a, [](float x, float) { return std::fabs(x); }); }
+inline F4 min4(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline F4 max4(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline F4 less4(F4 a, F4 b) { return lanes(a, b, [](float x, float y) { return x < y ? 1.f : 0.f; }); }
+inline F4 select4(F4 mask, F4 a, F4 b) {
+    F4 r;
+    for(int i = 0; i < 4; ++i) r.v[i] = mask.v[i] != 0.f ? a.v[i] : b.v[i];
+    return r;
+}
+
+#endif
+
+//same polynomial as fastAtan2()
+inline F4 atan2x4(F4 y, F4 x) {
+    F4 ax = abs4(x);
+    F4 ay = abs4(y);
+    //0/0 would be NaN, atan2(0, 0) is 0 here as in fastAtan2()
+    F4 a = min4(ax, ay) / max4(max4(ax, ay), F4::set(FLT_MIN));
+    F4 s = a * a;
+    F4 r = ((F4::set(-0.0464964749f) * s + F4::set(0.15931422f)) * s - F4::set(0.327622764f)) * s * a + a;
+    F4 zero = F4::set(0.f);
+    r = select4(less4(ax, ay), F4::set(PI / 2) - r, r);
+    r = select4(less4(x, zero), F4::set(PI) - r, r);
+    return select4(less4(y, zero), zero - r, r);
+}
+
+void mean(const float * x, const float * y, std::size_t n, float & mx, float & my) {
+    F4 sx = F4::set(0.f);
+    F4 sy = F4::set(0.f);
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        sx = sx + F4::load(x + i);
+        sy = sy + F4::load(y + i);
+    }
+    float tx = sx.sum();
+    float ty = sy.sum();
+    for(; i < n; ++i) {
+        tx += x[i];
+        ty += y[i];
+    }
+    mx = tx / n;
+    my = ty / n;
+}
+
+}
+
+const char * geometryIsa() {
+    return ISA;
+}
+
+void distances(const float * x, const float * y, std::size_t n, float cx, float cy, float * out) {
+    F4 vcx = F4::set(cx);
+    F4 vcy = F4::set(cy);
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        F4 dx = F4::load(x + i) - vcx;
+        F4 dy = F4::load(y + i) - vcy;
+        sqrt4(dx * dx + dy * dy).store(out + i);
+    }
+    for(; i < n; ++i) {
+        float dx = x[i] - cx;
+        float dy = y[i] - cy;
+        out[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+void segmentAngles(const float * x, const float * y, std::size_t n, float * out) {
+    if(n < 2) return;
+    std::size_t segments = n - 1;
+    std::size_t i = 0;
+    for(; i + 4 <= segments; i += 4) {
+        F4 dx = F4::load(x + i + 1) - F4::load(x + i);
+        F4 dy = F4::load(y + i + 1) - F4::load(y + i);
+        atan2x4(dy, dx).store(out + i);
+    }
+    for(; i < segments; ++i) {
+        out[i] = fastAtan2(y[i + 1] - y[i], x[i + 1] - x[i]);
+    }
+}
+
+float pathLength(const float * x, const float * y, std::size_t n) {
+    if(n < 2) return 0.f;
+    std::size_t segments = n - 1;
+    F4 sum = F4::set(0.f);
+    std::size_t i = 0;
+    for(; i + 4 <= segments; i += 4) {
+        F4 dx = F4::load(x + i + 1) - F4::load(x + i);
+        F4 dy = F4::load(y + i + 1) - F4::load(y + i);
+        sum = sum + sqrt4(dx * dx + dy * dy);
+    }
+    float length = sum.sum();
+    for(; i < segments; ++i) {
+        float dx = x[i + 1] - x[i];
+        float dy = y[i + 1] - y[i];
+        length += std::sqrt(dx * dx + dy * dy);
+    }
+    return length;
+}
+
+LineFit fitLine(const float * x, const float * y, std::size_t n) {
+    LineFit fit = {};
+    if(n == 0) return fit;
+    mean(x, y, n, fit.cx, fit.cy);
+
+    //second moments around the centroid
+    F4 mx = F4::set(fit.cx);
+    F4 my = F4::set(fit.cy);
+    F4 sxx = F4::set(0.f);
+    F4 syy = F4::set(0.f);
+    F4 sxy = F4::set(0.f);
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        F4 u = F4::load(x + i) - mx;
+        F4 v = F4::load(y + i) - my;
+        sxx = sxx + u * u;
+        syy = syy + v * v;
+        sxy = sxy + u * v;
+    }
+    float uu = sxx.sum();
+    float vv = syy.sum();
+    float uv = sxy.sum();
+    for(; i < n; ++i) {
+        float u = x[i] - fit.cx;
+        float v = y[i] - fit.cy;
+        uu += u * u;
+        vv += v * v;
+        uv += u * v;
+    }
+
+    //principal axis of the covariance, smaller eigenvalue is the squared residual
+    fit.angle = 0.5f * std::atan2(2.f * uv, uu - vv);
+    float half = 0.5f * (uu - vv);
+    float smallest = 0.5f * (uu + vv) - std::sqrt(half * half + uv * uv);
+    fit.rms = std::sqrt((smallest > 0.f ? smallest : 0.f) / n);
+    return fit;
+}
+
+CircleFit fitCircle(const float * x, const float * y, std::size_t n) {
+    CircleFit fit = {};
+    if(n < 3) return fit;
+    float mx;
+    float my;
+    mean(x, y, n, mx, my);
+
+    //Kasa: least squares of u^2 + v^2 + a*u + b*v + c = 0, centered for conditioning
+    F4 vmx = F4::set(mx);
+    F4 vmy = F4::set(my);
+    F4 suu = F4::set(0.f);
+    F4 svv = F4::set(0.f);
+    F4 suv = F4::set(0.f);
+    F4 su3 = F4::set(0.f);
+    F4 sv3 = F4::set(0.f);
+    F4 suvv = F4::set(0.f);
+    F4 svuu = F4::set(0.f);
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        F4 u = F4::load(x + i) - vmx;
+        F4 v = F4::load(y + i) - vmy;
+        F4 uu = u * u;
+        F4 vv = v * v;
+        suu = suu + uu;
+        svv = svv + vv;
+        suv = suv + u * v;
+        su3 = su3 + uu * u;
+        sv3 = sv3 + vv * v;
+        suvv = suvv + u * vv;
+        svuu = svuu + v * uu;
+    }
+    double Suu = suu.sum();
+    double Svv = svv.sum();
+    double Suv = suv.sum();
+    double Su3 = su3.sum();
+    double Sv3 = sv3.sum();
+    double Suvv = suvv.sum();
+    double Svuu = svuu.sum();
+    for(; i < n; ++i) {
+        double u = x[i] - mx;
+        double v = y[i] - my;
+        Suu += u * u;
+        Svv += v * v;
+        Suv += u * v;
+        Su3 += u * u * u;
+        Sv3 += v * v * v;
+        Suvv += u * v * v;
+        Svuu += v * u * u;
+    }
+
+    double det = Suu * Svv - Suv * Suv;
+    double spread = Suu + Svv;
+    if(spread <= 0.0 || std::fabs(det) < 1e-6 * spread * spread) return fit;
+
+    double bu = 0.5 * (Su3 + Suvv);
+    double bv = 0.5 * (Sv3 + Svuu);
+    double uc = (bu * Svv - bv * Suv) / det;
+    double vc = (Suu * bv - Suv * bu) / det;
+    fit.cx = static_cast<float>(uc + mx);
+    fit.cy = static_cast<float>(vc + my);
+    fit.radius = static_cast<float>(std::sqrt(uc * uc + vc * vc + spread / n));
+    fit.valid = true;
+
+    F4 vcx = F4::set(fit.cx);
+    F4 vcy = F4::set(fit.cy);
+    F4 vr = F4::set(fit.radius);
+    F4 err = F4::set(0.f);
+    i = 0;
+    for(; i + 4 <= n; i += 4) {
+        F4 dx = F4::load(x + i) - vcx;
+        F4 dy = F4::load(y + i) - vcy;
+        F4 d = sqrt4(dx * dx + dy * dy) - vr;
+        err = err + d * d;
+    }
+    float sq = err.sum();
+    for(; i < n; ++i) {
+        float dx = x[i] - fit.cx;
+        float dy = y[i] - fit.cy;
+        float d = std::sqrt(dx * dx + dy * dy) - fit.radius;
+        sq += d * d;
+    }
+    fit.rms = std::sqrt(sq / n);
+    return fit;
+}
+
+}
@@ -3,21 +3,36 @@
 
 #include "gestlib/GestureRecognizer.h"
 #include "gestlib/TouchDriver.h"
+#include "gestlib/Log.h"
+#include "gestlib/Probes.h"
 
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
 #include <iostream>
 #include <array>
 #include <fcntl.h>
 #include <unistd.h>
 #include <poll.h>
-
-constexpr auto IDLE_TIMEOUT = std::chrono::milliseconds(300);
+#include <cerrno>
+#include <algorithm>
 
 namespace GestLib {
 
 GestureRecognizer::GestureRecognizer() : _ofs(*this), _dri() {
     _running = false;
-    _gesturesQueue.clear();
+    _drainFrames = false;
+    _pipelined = false;
+    _framesSignalled = false;
+    _waitMode = WaitMode::Poll;
+    _overflow = OverflowPolicy::DropOldest;
+    _hasPendingMove = false;
+    _coalesced = 0;
+    _notified = false;
 }
 
 GestureRecognizer::~GestureRecognizer() {
@@ -30,6 +45,28 @@ bool GestureRecognizer::init() {
         return false;
     }
 
+    return initRecognition();
+}
+
+bool GestureRecognizer::initReplay(const std::string & capture, bool realtime) {
+    if(!_dri.initReplay(capture, realtime)) {
+        std::cout << "Failed to init fake driver" << std::endl;
+        return false;
+    }
+
+    return initRecognition();
+}
+
+bool GestureRecognizer::initReplayBuffer(const void * data, std::size_t size, bool realtime) {
+    if(!_dri.initReplayBuffer(data, size, realtime)) {
+        std::cout << "Failed to init fake driver" << std::endl;
+        return false;
+    }
+
+    return initRecognition();
+}
+
+bool GestureRecognizer::initRecognition() {
     if(!_ofs.init(_dri.resolutionX(), _dri.resolutionY())) {
         std::cout << "Failed to init real driver, try to use fake one" << std::endl;
         return false;
@@ -42,101 +79,707 @@ bool GestureRecognizer::init() {
         return false;
     }
 
+    _notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_notifyFd == -1) {
+        std::cout << "notify fd error" << std::endl;
+        return false;
+    }
+
+    _timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(_timerFd == -1) {
+        std::cout << "timerfd error" << std::endl;
+        return false;
+    }
+
     _dri.printCapabilities();
     _ofs.reset();
+    //recognition is live from here on: either start() takes over or caller pump()s
+    _running = true;
     return true;
 }
 
 bool GestureRecognizer::shutdown() {
     _running = false;
+    _config.unwatch();
 
     uint64_t u = 1;
     write(_efd, &u, sizeof(u));
 
-    _recognizer.join();
+    //pump() mode has no thread
+    if(_recognizer.joinable()) _recognizer.join();
+    if(_recognition.joinable()) _recognition.join();
     
     _dri.shutdown();
     close(_efd);
+    _efd = -1;
+    close(_notifyFd);
+    _notifyFd = -1;
+    close(_timerFd);
+    _timerFd = -1;
+    if(_frameFd != -1) close(_frameFd);
+    _frameFd = -1;
+    if(_stageTimerFd != -1) close(_stageTimerFd);
+    _stageTimerFd = -1;
+    if(_crashFd != -1) {
+        GestLib::dumpTraceOnCrash(nullptr, -1);
+        close(_crashFd);
+        _crashFd = -1;
+    }
 
     return true;
 }
 
+//stack recognizer thread may touch, faulted in before it matters
+constexpr std::size_t PREFAULT_STACK = 64 * 1024;
+//frames between pipeline stages
+constexpr std::size_t FRAME_QUEUE = 256;
+
+//faults in and locks stack below the caller, false if mlock() failed (pages are touched anyway)
+static bool prefaultStack() {
+    volatile char stack[PREFAULT_STACK];
+    long page = sysconf(_SC_PAGESIZE);
+    if(page <= 0) page = 4096;
+    for(std::size_t i = 0; i < PREFAULT_STACK; i += page) {
+        stack[i] = 0;
+    }
+    //volatile read keeps the writes from being optimized away
+    (void)stack[0];
+    return mlock(const_cast<char*>(stack), PREFAULT_STACK) == 0;
+}
+
+//spins of BusyPoll loop without input before backing off harder
+constexpr unsigned SPIN_FAST = 256;
+constexpr unsigned SPIN_PAUSE = 4096;
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+//read() of empty fd already costs a syscall, only then start to slow down
+static void backoff(unsigned idle) {
+    if(idle < SPIN_FAST) return;
+    if(idle < SPIN_PAUSE) {
+        for(int i = 0; i < 16; ++i) cpuRelax();
+        return;
+    }
+    sched_yield();
+}
+
+RealtimeStatus GestureRecognizer::applyRealtime() {
+    RealtimeStatus status;
+    const RealtimeConfig & cfg = _realtime;
+
+    if(!cfg.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : cfg.cpus) {
+            if(cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        status.pinned = err == 0;
+        if(err) GESTLIB_WARN("Realtime: affinity failed: " << strerror(err));
+        else GESTLIB_INFO("Realtime: affinity set");
+    }
+
+    if(cfg.policy != SchedPolicy::Other) {
+        int policy = cfg.policy == SchedPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+        int priority = std::max(sched_get_priority_min(policy), std::min(cfg.priority, sched_get_priority_max(policy)));
+        struct sched_param param = {};
+        param.sched_priority = priority;
+        int err = pthread_setschedparam(pthread_self(), policy, &param);
+
+        //unprivileged user may still get realtime up to RLIMIT_RTPRIO
+        struct rlimit limit;
+        if(err == EPERM && getrlimit(RLIMIT_RTPRIO, &limit) == 0 &&
+            limit.rlim_cur > 0 && limit.rlim_cur < static_cast<rlim_t>(priority)) {
+            priority = static_cast<int>(limit.rlim_cur);
+            param.sched_priority = priority;
+            err = pthread_setschedparam(pthread_self(), policy, &param);
+        }
+
+        if(err == 0) {
+            status.scheduled = true;
+            status.priority = priority;
+            GESTLIB_INFO("Realtime: " << (policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR") << " priority " << priority);
+        } else {
+            GESTLIB_WARN("Realtime: scheduling policy not changed (" << strerror(err) << "), staying on SCHED_OTHER");
+        }
+    }
+
+    if(cfg.lockMemory) {
+        //only what recognition touches; mlockall() would pin the whole host process
+        bool locked = _dri.lockMemory();
+        locked = mlock(_queue.storage(), _queue.storageSize()) == 0 && locked;
+        if(_pipelined) locked = mlock(_frames.storage(), _frames.storageSize()) == 0 && locked;
+        locked = prefaultStack() && locked;
+        status.memoryLocked = locked;
+        if(locked) GESTLIB_INFO("Realtime: buffers and stack locked");
+        else GESTLIB_WARN("Realtime: mlock failed (" << strerror(errno) << "), pages may still be swapped out");
+    }
+
+    return status;
+}
+
 //TODO: no actual check's here, always returns true!!
 bool GestureRecognizer::start() {
     _running = true;
 
-    auto iteration = [this]() {    
-        struct pollfd fds[2];
+    if(_pipelined && !startPipeline()) {
+        std::cout << "Failed to start pipeline, recognizing on one thread" << std::endl;
+        _pipelined = false;
+    }
+
+    //reader stage only hands frames over, otherwise the whole recognition happens here
+    auto step = [this]() {
+        bool attached = this->_dri.fd() >= 0;
+        bool data = this->_pipelined ? this->readStage() : this->iterate(this->_dri.now());
+        //device may be back already and its inotify event handled while old fd still looked fine
+        if(attached && this->_dri.fd() < 0) this->_dri.reattach();
+        return data;
+    };
+
+    auto iteration = [this, step]() {    
+        this->applyRealtime();
+
+        struct pollfd fds[4];
         fds[0].fd = this->_dri.fd();
         fds[0].events = POLLIN;
         fds[1].fd = this->_efd;
         fds[1].events = POLLIN;
+        fds[2].fd = this->_dri.hotplugFd();
+        fds[2].events = POLLIN;
+        fds[3].fd = this->_timerFd;
+        fds[3].events = POLLIN;
+        unsigned idle = 0;
 
         while(this->_running) {    
-            int ret = 0;
-            auto now = std::chrono::steady_clock::now();
-            if(std::chrono::duration_cast<std::chrono::milliseconds>(now - this->_lastAction) > IDLE_TIMEOUT) {
-                ret = poll(fds, 2, -1);
-            } else {
-                ret = poll(fds, 2, 20);
+            //never sleeps: every spin reads fd and checks FSM/driver timeouts against current time.
+            //Unplugged device falls through to poll() below to wait for hot-plug
+            if(this->_waitMode == WaitMode::BusyPoll && this->_dri.fd() >= 0) {
+                if(step()) {
+                    idle = 0;
+                } else {
+                    backoff(idle++);
+                }
+                continue;
             }
+
+            //-1 while device is unplugged, poll() skips it
+            fds[0].fd = this->_dri.fd();
+            this->armDeadline(this->_timerFd, true, !this->_pipelined);
+
+            //driver still holds frames from last read - don't sleep, otherwise
+            //only input or the next FSM/driver deadline wakes us up
+            int ret = poll(fds, 4, this->_dri.pending() ? 0 : -1);
             
             if(ret < 0) {
-                std::cout << "some error" << std::endl;
-            } else if(ret == 0) {
-                //...
-                // std::cout << "ret=0" << std::endl;
-            } else if(ret > 0) {
-                this->_lastAction = std::chrono::steady_clock::now();
+                if(errno != EINTR) GESTLIB_ERROR("poll failed: " << strerror(errno));
+                continue;
             }
 
             if(fds[1].revents & POLLIN) {
                 continue;
             }
 
-            std::vector<TouchEvent> touches = this->_dri.getEvents();
-            std::size_t size = touches.size();
-                    
-            if(size == 0) {
-                this->_ofs.resetOrProcess(/*touches*/);
-            }else if(size == 1) {
-                this->_ofs.process(touches);
-            } else if(size == 2) {
-                this->_ofs.reset();
-            } else if(size == 3) {
-                this->_ofs.reset();
-            }    
-
-            // for(int i=0; i<touches.size(); ++i) {
-            //     TouchEvent & ev = touches.at(i);
-            //     std::string type;
-            //     if(ev.type == TouchEvent::Type::Begin) type = "Begin";
-            //     else if(ev.type == TouchEvent::Type::Move) type = "Move";
-            //     else if(ev.type == TouchEvent::Type::End) type = "End";
-            //     std::cout << "id: " << ev.id <<
-            //                 " type : " << type <<
-            //                 " x: " << ev.x <<
-            //                 " y: " << ev.y << std::endl;
-            // } 
+            if(fds[2].revents & POLLIN) {
+                this->_dri.handleHotplug();
+            }
+
+            if(fds[3].revents & POLLIN) {
+                uint64_t expirations;
+                read(this->_timerFd, &expirations, sizeof(expirations));
+            }
+
+            step();
         }  
     };
 
     _recognizer = std::thread(iteration);
+    if(_pipelined) {
+        _recognition = std::thread([this]() {
+            //FSM work is what has to keep up, same settings as the reader
+            this->applyRealtime();
+            this->recognitionLoop();
+        });
+    }
     return true;
 }
 
-void GestureRecognizer::pushGesture(Gesture gest) {
-    std::unique_lock<std::mutex> lock(_lock);
-    _gesturesQueue.push_back(gest);
+bool GestureRecognizer::startPipeline() {
+    _frames.resize(FRAME_QUEUE);
+    _framesSignalled = false;
+
+    if(_frameFd == -1) _frameFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_stageTimerFd == -1) _stageTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return _frameFd != -1 && _stageTimerFd != -1;
 }
 
-std::vector<Gesture> GestureRecognizer::fetchGestures() {
-    std::vector<Gesture> ret;
+//reader stage: drains every ready frame into _frames, no FSM work so kernel queue never waits for it
+bool GestureRecognizer::readStage() {
+    std::vector<TouchEvent> & touches = _touches;
+    _dri.config(_driverConfig.refresh());
+    bool anyFrame = false;
+    std::chrono::time_point<std::chrono::steady_clock> readAt = latencyNow();
+    while(_running && _dri.getFrame(touches)) {
+        anyFrame = true;
+        pushFrame(touches, readAt);
+        readAt = latencyNow();
+    }
+    if(!anyFrame) {
+        //finger timeouts may end touches too
+        _dri.tick(touches);
+        pushFrame(touches, std::chrono::time_point<std::chrono::steady_clock>());
+    }
+
+    signalFrames();
+    return anyFrame;
+}
+
+void GestureRecognizer::pushFrame(const std::vector<TouchEvent> & touches,
+                                    std::chrono::time_point<std::chrono::steady_clock> readAt) {
+    //FSM timeouts run on recognition stage's own timer, empty frame tells it nothing
+    if(touches.empty()) return;
+
+    TouchFrame frame;
+    //when the frame happened, not when it was read: recognition stage runs FSM timers up to it
+    frame.time = touches[0].time;
+    frame.readAt = readAt;
+    frame.outAt = latencyNow();
+    frame.count = static_cast<int>(touches.size());
+    std::copy_n(touches.begin(), std::min(touches.size(), static_cast<std::size_t>(FRAME_TOUCHES)), frame.touches);
+
+    //Recognition stage is a whole queue behind. Nothing is dropped here, a lost Begin or End would leave FSM
+    //in the middle of a gesture (and merged Move's change what it sees too). Reader waits instead, input piles up
+    //in the kernel and if that overflows driver resyncs (SYN_DROPPED) and ends fingers properly
+    if(waitFrameRoom()) _frames.push(frame, false);
+}
+
+//reader stage backs off while the queue is full, false on shutdown
+bool GestureRecognizer::waitFrameRoom() {
+    unsigned idle = 0;
+    while(_frames.full()) {
+        if(!_running) return false;
+        //what's staged has to be visible (and recognition stage awake) to make room
+        signalFrames();
+        backoff(idle++);
+    }
+    return true;
+}
+
+void GestureRecognizer::signalFrames() {
+    if(_frames.publish() > 0 && !_framesSignalled.exchange(true)) {
+        uint64_t u = 1;
+        write(_frameFd, &u, sizeof(u));
+    }
+}
+
+void GestureRecognizer::recognitionLoop() {
+    struct pollfd fds[3];
+    fds[0].fd = _frameFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _efd;
+    fds[1].events = POLLIN;
+    fds[2].fd = _stageTimerFd;
+    fds[2].events = POLLIN;
+    std::vector<TouchEvent> & touches = _stageTouches;
+    touches.reserve(FRAME_TOUCHES);
+    std::chrono::time_point<std::chrono::steady_clock> lastDispatch = _dri.now();
+
+    while(_running) {
+        armDeadline(_stageTimerFd, false, true);
+
+        int ret = poll(fds, 3, -1);
+        if(ret < 0) {
+            if(errno != EINTR) GESTLIB_ERROR("poll failed: " << strerror(errno));
+            continue;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            continue;
+        }
+
+        if(fds[2].revents & POLLIN) {
+            uint64_t expirations;
+            read(_stageTimerFd, &expirations, sizeof(expirations));
+        }
+
+        if(fds[0].revents & POLLIN) {
+            uint64_t u;
+            read(_frameFd, &u, sizeof(u));
+            //pairs with exchange in readStage(), frames published before it are visible now
+            _framesSignalled.exchange(false);
+        }
+
+        TouchFrame frame;
+        bool anyFrame = false;
+        while(_running && _frames.tryPop(frame)) {
+            anyFrame = true;
+            touches.assign(frame.touches, frame.touches + std::min(frame.count, FRAME_TOUCHES));
+            //epoch readAt: frame came from a timeout or latency isn't measured
+            if(_latency && frame.readAt.time_since_epoch().count() != 0) {
+                _frameStamped = true;
+                _frameKernel = frame.touches[0].time;
+                _frameReadAt = frame.readAt;
+                _frameOutAt = frame.outAt;
+            }
+            catchUp(lastDispatch, frame.time);
+            dispatch(touches, frame.time);
+            lastDispatch = frame.time;
+        }
+        if(!anyFrame) {
+            touches.clear();
+            lastDispatch = _dri.now();
+            dispatch(touches, lastDispatch);
+        }
+    }
+}
+
+//queue was behind: FSM timers that ran out between two frames fire before the later one, as they would have live
+void GestureRecognizer::catchUp(std::chrono::time_point<std::chrono::steady_clock> from,
+                                std::chrono::time_point<std::chrono::steady_clock> to) {
+    std::chrono::time_point<std::chrono::steady_clock> deadline;
+    for(int guard = 0; guard < 8 && _ofs.nextDeadline(from, deadline) && deadline <= to; ++guard) {
+        _ofs.resetOrProcess(deadline);
+        from = deadline;
+    }
+}
+
+void GestureRecognizer::pump(std::chrono::time_point<std::chrono::steady_clock> now) {
+    bool attached = _dri.fd() >= 0;
+    iterate(now);
+    //same as in start(): don't count on another inotify event
+    if(attached && _dri.fd() < 0) _dri.reattach();
+}
+
+bool GestureRecognizer::handleHotplug() {
+    return _dri.handleHotplug();
+}
+
+int GestureRecognizer::pumpTimeout() {
+    if(_dri.pending()) return 0;
+
+    std::chrono::time_point<std::chrono::steady_clock> now = _dri.now();
+    std::chrono::time_point<std::chrono::steady_clock> deadline;
+    if(!nextDeadline(now, deadline)) return -1;
+
+    //round up, waking a bit early would only give another empty pump
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    return static_cast<int>((us + 999) / 1000);
+}
+
+//reads whatever input is ready (or just runs timeouts) and feeds FSM, true if there was input
+bool GestureRecognizer::iterate(std::chrono::time_point<std::chrono::steady_clock> now) {
+    std::vector<TouchEvent> & touches = _touches;
+    _dri.config(_driverConfig.refresh());
+    if(_drainFrames) {
+        //run every ready frame through driver and FSM, oldest first
+        bool anyFrame = false;
+        std::chrono::time_point<std::chrono::steady_clock> readAt = latencyNow();
+        std::chrono::time_point<std::chrono::steady_clock> last;
+        while(_running && _dri.getFrame(touches)) {
+            //each frame on its own time, FSM timers that ran out between frames fire in between as they would have live
+            std::chrono::time_point<std::chrono::steady_clock> at = _dri.frameTime();
+            catchUp(anyFrame ? last : at, at);
+            anyFrame = true;
+            stampFrame(touches, readAt);
+            dispatch(touches, at);
+            last = at;
+            readAt = latencyNow();
+        }
+        if(!anyFrame) {
+            _dri.tick(touches);
+            dispatch(touches, now);
+        }
+        return anyFrame;
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> readAt = latencyNow();
+    bool data = _dri.getEvents(touches);
+    if(data) stampFrame(touches, readAt);
+    dispatch(touches, now);
+    return data;
+}
+
+//earliest moment driver or FSM has something to decide without new input
+bool GestureRecognizer::nextDeadline(std::chrono::time_point<std::chrono::steady_clock> now,
+                                        std::chrono::time_point<std::chrono::steady_clock> & deadline,
+                                        bool driver, bool fsm) {
+    std::chrono::time_point<std::chrono::steady_clock> driverAt;
+    std::chrono::time_point<std::chrono::steady_clock> fsmAt;
+    bool hasDriver = driver && _dri.nextDeadline(now, driverAt);
+    bool hasFsm = fsm && _ofs.nextDeadline(now, fsmAt);
+
+    if(hasDriver && hasFsm) deadline = std::min(driverAt, fsmAt);
+    else if(hasDriver) deadline = driverAt;
+    else if(hasFsm) deadline = fsmAt;
+    return hasDriver || hasFsm;
+}
+
+void GestureRecognizer::armDeadline(int timerFd, bool driver, bool fsm) {
+    //relative: in fast replay driver's clock is not steady_clock
+    std::chrono::time_point<std::chrono::steady_clock> now = _dri.now();
+    std::chrono::time_point<std::chrono::steady_clock> deadline;
+    struct itimerspec spec = {};
+
+    if(nextDeadline(now, deadline, driver, fsm)) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+        if(ns < 1) ns = 1; //zero would disarm
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+    }
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+}
+
+void GestureRecognizer::dispatch(std::vector<TouchEvent> & touches,
+                                    std::chrono::time_point<std::chrono::steady_clock> now) {
+    std::size_t size = touches.size();
+    _ofs.config(_fsmConfig.refresh());
+            
+    if(size == 0) {
+        _ofs.resetOrProcess(now);
+    }else if(size == 1) {
+        _ofs.process(touches);
+    } else if(size == 2) {
+        _ofs.reset();
+    } else if(size == 3) {
+        _ofs.reset();
+    }    
+
+    //everything one frame produced becomes visible at once
+    publishGestures();
+    _frameStamped = false;
+}
+
+//state (-1 if gesture has none) and position of any gesture
+static void gestureInfo(const Gesture & g, int32_t & state, int32_t & x, int32_t & y) {
+    state = -1;
+    x = 0;
+    y = 0;
+    switch(g.type) {
+        case(Gestures::TouchDown): x = g.touchDown.x; y = g.touchDown.y; break;
+        case(Gestures::TouchUp): x = g.touchUp.x; y = g.touchUp.y; break;
+        case(Gestures::Tap): x = g.tap.x; y = g.tap.y; break;
+        case(Gestures::DoubleTap): x = g.doubleTap.x; y = g.doubleTap.y; break;
+        case(Gestures::Hold): state = static_cast<int32_t>(g.hold.state); x = g.hold.x; y = g.hold.y; break;
+        case(Gestures::Swipe): state = static_cast<int32_t>(g.swipe.state); x = g.swipe.x; y = g.swipe.y; break;
+        case(Gestures::Drag): state = static_cast<int32_t>(g.drag.state); x = g.drag.x; y = g.drag.y; break;
+        case(Gestures::DoubleTapSwipe): state = static_cast<int32_t>(g.dtSwipe.state); x = g.dtSwipe.x; y = g.dtSwipe.y; break;
+        case(Gestures::DoubleTapCircular): state = static_cast<int32_t>(g.dtCircular.state); x = g.dtCircular.x; y = g.dtCircular.y; break;
+        default: break;
+    }
+}
+
+static bool isMove(const Gesture & g) {
+    switch(g.type) {
+        case(Gestures::Hold): return g.hold.state == GestureState::Move;
+        case(Gestures::Swipe): return g.swipe.state == GestureState::Move;
+        case(Gestures::Drag): return g.drag.state == GestureState::Move;
+        case(Gestures::DoubleTapSwipe): return g.dtSwipe.state == GestureState::Move;
+        case(Gestures::DoubleTapCircular): return g.dtCircular.state == GestureState::Move;
+        default: return false;
+    }
+}
+
+//newer position, summed deltas
+static void mergeMove(Gesture & into, const Gesture & g) {
+    into.time = g.time;
+    switch(g.type) {
+        case(Gestures::Hold): into.hold = { g.hold.state, g.hold.x, g.hold.y, into.hold.dx + g.hold.dx, into.hold.dy + g.hold.dy }; break;
+        case(Gestures::Swipe): into.swipe = { g.swipe.state, g.swipe.x, g.swipe.y, into.swipe.dx + g.swipe.dx, into.swipe.dy + g.swipe.dy }; break;
+        case(Gestures::Drag): into.drag = { g.drag.state, g.drag.x, g.drag.y, into.drag.dx + g.drag.dx, into.drag.dy + g.drag.dy }; break;
+        case(Gestures::DoubleTapSwipe): into.dtSwipe = { g.dtSwipe.state, g.dtSwipe.x, g.dtSwipe.y, into.dtSwipe.dx + g.dtSwipe.dx, into.dtSwipe.dy + g.dtSwipe.dy }; break;
+        case(Gestures::DoubleTapCircular): {
+            float deltaAngle = into.dtCircular.deltaAngle + g.dtCircular.deltaAngle;
+            into.dtCircular = g.dtCircular;
+            into.dtCircular.deltaAngle = deltaAngle;
+        } break;
+        default: break;
+    }
+}
+
+//recognizer thread only; becomes visible for consumer on publishGestures()
+void GestureRecognizer::pushGesture(Gesture gest, std::chrono::time_point<std::chrono::steady_clock> time) {
+    gest.time = time;
+    bump(_gestureCounts[static_cast<int>(gest.type)]);
+    if(_trace.enabled()) traceGesture(gest);
+#ifdef GESTLIB_USDT
     {
-        std::unique_lock<std::mutex> lock(_lock);
-        ret = std::move(_gesturesQueue);
+        int32_t state, x, y;
+        gestureInfo(gest, state, x, y);
+        GESTLIB_PROBE(push, static_cast<int>(gest.type), state, x, y);
+    }
+#endif
+    if(_latency) recordPush(gest);
+
+    if(_callback) {
+        if(_latency) recordFetch(&gest, 1);
+        _callback(gest);
+        return;
+    }
+
+    if(_overflow == OverflowPolicy::DropOldest) {
+        _queue.push(gest, true);
+        return;
+    }
+
+    if(_hasPendingMove) {
+        if(_queue.full() && isMove(gest) && gest.type == _pendingMove.type) {
+            mergeMove(_pendingMove, gest);
+            _coalesced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        //keep order: held Move goes first
+        _queue.push(_pendingMove, true);
+        _hasPendingMove = false;
+    }
+
+    if(_queue.full() && isMove(gest)) {
+        _pendingMove = gest;
+        _hasPendingMove = true;
+        return;
+    }
+    _queue.push(gest, true);
+}
+
+void GestureRecognizer::publishGestures() {
+    if(_hasPendingMove && !_queue.full()) {
+        _queue.push(_pendingMove, false);
+        _hasPendingMove = false;
+    }
+    if(_queue.publish() > 0 && !_notified.exchange(true)) {
+        uint64_t u = 1;
+        write(_notifyFd, &u, sizeof(u));
     }
+}
+
+void GestureRecognizer::clearNotification() {
+    uint64_t u;
+    read(_notifyFd, &u, sizeof(u));
+    //pairs with exchange in publishGestures(), everything published before it is visible now
+    _notified.exchange(false);
+}
+
+std::size_t GestureRecognizer::fetchGestures(Gesture * out, std::size_t max) {
+    std::size_t count = _queue.pop(out, max);
+    if(_latency) recordFetch(out, count);
+    GESTLIB_PROBE(fetch, count, _queue.size());
+    return count;
+}
+
+bool GestureRecognizer::tryPop(Gesture & out) {
+    return fetchGestures(&out, 1) == 1;
+}
+
+std::vector<Gesture> GestureRecognizer::fetchGestures() {
+    std::vector<Gesture> ret(_queue.size());
+    ret.resize(fetchGestures(ret.data(), ret.size()));
     return ret;
 }
 
+void GestureRecognizer::trace(std::size_t capacity) {
+    _trace.resize(capacity);
+    _ofs.trace(_trace.enabled() ? &_trace : nullptr);
+}
+
+bool GestureRecognizer::dumpTraceOnCrash(const std::string & path) {
+    if(!_trace.enabled()) return false;
+
+    //opened now, signal handler can only write()
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        std::cerr << "Failed to open trace dump " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if(_crashFd != -1) close(_crashFd);
+    _crashFd = fd;
+    return GestLib::dumpTraceOnCrash(&_trace, fd);
+}
+
+void GestureRecognizer::traceGesture(const Gesture & g) {
+    int32_t state, x, y;
+    gestureInfo(g, state, x, y);
+    _trace.record(TraceKind::Gesture, static_cast<uint16_t>(g.type), state, x, y);
+}
+
+RecognizerStats GestureRecognizer::stats() const {
+    RecognizerStats s;
+    s.driver = _dri.stats();
+    s.transitions = _ofs.transitions();
+    for(int i = 0; i < GESTURE_TYPES; ++i) {
+        s.gestures[i] = _gestureCounts[i].load(std::memory_order_relaxed);
+    }
+    s.queueHighWater = _queue.highWater();
+    s.queueDropped = droppedGestures();
+    s.frameQueueHighWater = _frames.highWater();
+    s.frameQueueDropped = _frames.dropped();
+    return s;
+}
+
+void GestureRecognizer::measureLatency(bool measure) {
+    if(!measure) {
+        _latency.reset();
+    } else if(!_latency) {
+        _latency.reset(new LatencyHistogram[GESTURE_TYPES * LATENCY_STAGES]);
+    }
+}
+
+LatencySummary GestureRecognizer::latency(Gestures type, LatencyStage stage) const {
+    if(!_latency) return LatencySummary{};
+    return histogram(type, stage).summary();
+}
+
+const LatencyHistogram * GestureRecognizer::latencyHistogram(Gestures type, LatencyStage stage) const {
+    if(!_latency) return nullptr;
+    return &histogram(type, stage);
+}
+
+void GestureRecognizer::resetLatency() {
+    if(!_latency) return;
+    for(int i = 0; i < GESTURE_TYPES * LATENCY_STAGES; ++i) {
+        _latency[i].reset();
+    }
+}
+
+LatencyHistogram & GestureRecognizer::histogram(Gestures type, LatencyStage stage) const {
+    return _latency[static_cast<int>(type) * LATENCY_STAGES + static_cast<int>(stage)];
+}
+
+//epoch when not measuring, so callers don't pay for the clock read
+std::chrono::time_point<std::chrono::steady_clock> GestureRecognizer::latencyNow() const {
+    if(!_latency) return std::chrono::time_point<std::chrono::steady_clock>();
+    return std::chrono::steady_clock::now();
+}
+
+void GestureRecognizer::stampFrame(const std::vector<TouchEvent> & touches,
+                                    std::chrono::time_point<std::chrono::steady_clock> readAt) {
+    if(!_latency || touches.empty()) return;
+    _frameStamped = true;
+    _frameKernel = touches[0].time;
+    _frameReadAt = readAt;
+    _frameOutAt = std::chrono::steady_clock::now();
+}
+
+void GestureRecognizer::recordPush(Gesture & gest) {
+    gest.pushed = std::chrono::steady_clock::now();
+    if(!_frameStamped) return;
+
+    histogram(gest.type, LatencyStage::Read).record(_frameReadAt - _frameKernel);
+    histogram(gest.type, LatencyStage::Driver).record(_frameOutAt - _frameReadAt);
+    histogram(gest.type, LatencyStage::Push).record(gest.pushed - _frameOutAt);
+}
+
+void GestureRecognizer::recordFetch(const Gesture * gestures, std::size_t count) {
+    if(count == 0) return;
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < count; ++i) {
+        const Gesture & g = gestures[i];
+        histogram(g.type, LatencyStage::Fetch).record(now - g.pushed);
+        histogram(g.type, LatencyStage::Total).record(now - g.time);
+    }
+}
+
 }//namespace
\ No newline at end of file
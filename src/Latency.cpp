@@ -0,0 +1,86 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#include "gestlib/Latency.h"
+
+#include <algorithm>
+
+namespace GestLib {
+
+int LatencyHistogram::bucketOf(std::uint64_t ns) {
+    if(ns < static_cast<std::uint64_t>(SUB_COUNT)) return static_cast<int>(ns);
+
+    int magnitude = 63 - __builtin_clzll(ns);
+    if(magnitude >= MAX_BITS) return BUCKETS - 1;
+
+    int shift = magnitude - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + static_cast<int>(ns >> shift) - SUB_COUNT;
+}
+
+std::uint64_t LatencyHistogram::bucketFloor(int bucket) {
+    if(bucket < SUB_COUNT) return bucket;
+
+    int shift = bucket / SUB_COUNT - 1;
+    return static_cast<std::uint64_t>(bucket % SUB_COUNT + SUB_COUNT) << shift;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds value) {
+    //clocks of kernel and userspace disagree when EVIOCSCLOCKID isn't supported
+    std::uint64_t ns = value.count() > 0 ? static_cast<std::uint64_t>(value.count()) : 0;
+    _counts[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    std::uint64_t min = _min.load(std::memory_order_relaxed);
+    while(ns < min && !_min.compare_exchange_weak(min, ns, std::memory_order_relaxed)) {}
+    std::uint64_t max = _max.load(std::memory_order_relaxed);
+    while(ns > max && !_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset() {
+    for(std::atomic<std::uint64_t> & count : _counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    _min.store(UINT64_MAX, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::count() const {
+    std::uint64_t total = 0;
+    for(const std::atomic<std::uint64_t> & count : _counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double q) const {
+    std::uint64_t total = count();
+    if(total == 0) return std::chrono::nanoseconds(0);
+
+    std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(q, 0.0, 1.0) * total);
+    if(rank == 0) rank = 1;
+
+    std::uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; ++i) {
+        seen += _counts[i].load(std::memory_order_relaxed);
+        if(seen >= rank) {
+            std::uint64_t upper = i + 1 < BUCKETS ? bucketFloor(i + 1) - 1 : bucketFloor(i);
+            //never report more than was actually seen
+            return std::chrono::nanoseconds(std::min(upper, _max.load(std::memory_order_relaxed)));
+        }
+    }
+    return std::chrono::nanoseconds(_max.load(std::memory_order_relaxed));
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary s;
+    s.count = count();
+    std::uint64_t min = _min.load(std::memory_order_relaxed);
+    s.min = std::chrono::nanoseconds(s.count ? min : 0);
+    s.p50 = percentile(0.5);
+    s.p90 = percentile(0.9);
+    s.p99 = percentile(0.99);
+    s.p999 = percentile(0.999);
+    s.max = std::chrono::nanoseconds(_max.load(std::memory_order_relaxed));
+    return s;
+}
+
+}
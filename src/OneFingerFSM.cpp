@@ -5,25 +5,19 @@
 
 #include "gestlib/GestureRecognizer.h"
 #include "gestlib/Gestures.h"
+#include "gestlib/Log.h"
+#include "gestlib/Probes.h"
+#include "gestlib/Trajectory.h"
+#include "gestlib/Geometry.h"
+#include "gestlib/FsmEngine.h"
 
 #include <cmath>
 #include <algorithm>
-#include <iostream>
-
-float distance(const GestLib::TouchEvent & p1, const GestLib::TouchEvent & p2) {
-    float dx = p2.x - p1.x;
-    float dy = p2.y - p1.y;
-    return std::sqrt(dx * dx + dy * dy);
-}
 
 float dotProduct(const GestLib::TouchEvent & a, const GestLib::TouchEvent & b) {
     return a.x * b.x + a.y * b.y;
 }
 
-float getAngle(float x, float y, float cx, float cy) {
-    return std::atan2(y - cy, x - cx); // ∈ [-π, π]
-}
-
 float pointToLineDistance(float x1, float y1, float x2, float y2, float px, float py) {
     float dx = x2 - x1;
     float dy = y2 - y1;
@@ -37,62 +31,61 @@ float pointToLineDistance(float x1, float y1, float x2, float y2, float px, floa
     return std::sqrt(distX*distX + distY*distY);
 }
 
-float computeTurnAngleSum(const std::deque<GestLib::TouchEvent>& history) {
-    std::size_t size = history.size();
-    if (size < 10+2) return 0.0f;
-
-    float totalAngle = 0.0f;
-    //let's use some window of last 10 events
-    for (size_t i = size-10; i < size; ++i) {
-        float dx1 = history[i - 1].x - history[i - 2].x;
-        float dy1 = history[i - 1].y - history[i - 2].y;
-        float dx2 = history[i].x - history[i - 1].x;
-        float dy2 = history[i].y - history[i - 1].y;
-
-        float len1 = std::sqrt(dx1 * dx1 + dy1 * dy1);
-        float len2 = std::sqrt(dx2 * dx2 + dy2 * dy2);
-
-        if (len1 < 1e-3f || len2 < 1e-3f)
-            continue;
+int resLerp(int x, int inMax, int outMax) {
+    return x * outMax / inMax;
+}
 
-        float dot = (dx1 * dx2 + dy1 * dy2) / (len1 * len2);
-        dot = std::clamp(dot, -1.0f, 1.0f);  
+namespace GestLib {
 
-        float angle = std::acos(dot);
-        totalAngle += std::abs(angle);
+const char * OneFingerFSM::stateName(state state) {
+    switch(state) {
+        case(Idle): return "Idle";
+        case(Stroke): return "Stroke";
+        case(DragOrHold): return "DragOrHold";
+        case(DragOngoing): return "DragOngoing";
+        case(DoubleTapPossible): return "DoubleTapPossible";
+        case(DoubleTapSwipeOngoing): return "DoubleTapSwipeOngoing";
+        case(DoubleTapCircularOngoing): return "DoubleTapCircularOngoing";
+        case(SwipeOngoing): return "SwipeOngoing";
+        case(Hold): return "Hold";
+        case(HoldOngoing): return "HoldOngoing";
     }
-
-    return totalAngle;
+    return "?";
 }
 
-int resLerp(int x, int inMax, int outMax) {
-    return x * outMax / inMax;
+//every state change goes through here so it can be counted and traced
+void OneFingerFSM::setState(state state) {
+    if(_state != state) {
+        bump(_transitions[state]);
+        if(_trace) _trace->record(TraceKind::State, state, _state);
+        GESTLIB_PROBE(fsm_state, static_cast<int>(_state), static_cast<int>(state));
+        GESTLIB_TRACE("FSM: " << stateName(_state) << " -> " << stateName(state));
+    }
+    _state = state;
 }
 
-float normalize_angle(float angle) {
-    while (angle <= -M_PI) angle += 2.0f * M_PI;
-    while (angle >  M_PI)  angle -= 2.0f * M_PI;
-    return angle;
+void OneFingerFSM::startTimer(timer & t, int timeout, timer::timePoint & now) {
+    t.start(timeout, now);
+    if(_trace) _trace->record(TraceKind::TimerStart, static_cast<uint16_t>(t.id()), timeout);
 }
 
-namespace GestLib {
+bool OneFingerFSM::timerExpired(timer & t, timer::timePoint & now) {
+    if(!t.active() || !t.expired(now)) return false;
+    if(_trace) _trace->record(TraceKind::TimerExpire, static_cast<uint16_t>(t.id()));
+    return true;
+}
 
-void OneFingerFSM::printState(state state) {
-    switch(state) {
-        case(Idle): std::cout << "Idle" << std::endl; break;
-        case(Stroke): std::cout << "Stroke" << std::endl; break;
-        case(DragOrHold): std::cout << "DragOrHold" << std::endl; break;
-        case(DragOngoing): std::cout << "DragOngoing" << std::endl; break;
-        case(DoubleTapPossible): std::cout << "DoubleTapPossible" << std::endl; break;
-        case(DoubleTapSwipeOngoing): std::cout << "DoubleTapSwipeOngoing" << std::endl; break;
-        case(DoubleTapCircularOngoing): std::cout << "DoubleTapCircularOngoing" << std::endl; break;
-        case(SwipeOngoing): std::cout << "SwipeOngoing" << std::endl; break;
-        case(Hold): std::cout << "Hold" << std::endl; break;
+std::array<std::uint64_t, FSM_STATES> OneFingerFSM::transitions() const {
+    std::array<std::uint64_t, FSM_STATES> ret;
+    for(int i = 0; i < FSM_STATES; ++i) {
+        ret[i] = _transitions[i].load(std::memory_order_relaxed);
     }
+    return ret;
 }
 
 OneFingerFSM::OneFingerFSM(GestureRecognizer & rec) : _recognizer(rec) {
     _doubleTapHelper = Undetected;
+    _predictions = 0;
 }
 
 bool OneFingerFSM::init(int resX, int resY) {
@@ -107,483 +100,276 @@ void OneFingerFSM::expectedResolution(int x, int y) {
     _expectedY = y;
 }
 
-void OneFingerFSM::process(std::vector<TouchEvent> & touches) {
-    TouchEvent & event = touches[0];
-    timer::timePoint now = std::chrono::steady_clock::now();
-    // printState(_state);
-    switch(_state) {
-        case(Idle): {
-            if(event.type != TouchEvent::Type::Begin) return;
-            _startEvent = event;
-            _tapTimer.start(300, now);
-            _dragOrHoldTimer.start(200, now);
-            _holdTimer.start(800, now);
-            _state = Stroke;
-            Gesture t;
-            t.type = Gestures::TouchDown;
-            t.touchDown = {
-                .x = resLerp(event.x, _resolutionX, _expectedX),
-                .y = resLerp(event.y, _resolutionY, _expectedY)
-            };
-            _recognizer.pushGesture(t);
-        } break;
-        case(Stroke): {
-            if(event.type != TouchEvent::Type::End && event.id == _startEvent.id) {
-                _tapTimer.stop();
-                if(event.id == _startEvent.id) {
-                    if(_lastEvent.type != TouchEvent::Type::Move) {
-                        if(_dragOrHoldTimer.active() && _dragOrHoldTimer.expired(now)) {
-                            _state = DragOrHold;
-                        } 
-                    } else {
-                        float dist = distance(event, _startEvent);
-                        if(dist >= 10) {
-                            Gesture swipe;
-                            swipe.type = Gestures::Swipe;
-                            swipe.swipe = {
-                                .state = GestureState::Start,
-                                .x = resLerp(_startEvent.x, _resolutionX, _expectedX),
-                                .y = resLerp(_startEvent.y, _resolutionY, _expectedY),
-                                .dx = 0,
-                                .dy = 0
-                            }; 
-                            _recognizer.pushGesture(swipe);
-                            _state = SwipeOngoing;
-                        }
-                    }
-                }
-            } else if(event.type == TouchEvent::Type::Begin && event.id != _startEvent.id) {
-                _doubleTapTimer.start(200, now);
-                _state = DoubleTapPossible;
-            }
-        } break;
-        case(DragOrHold): {
-            if(event.id != _startEvent.id) {
-                reset();
-            }
-            
-            if(event.type == TouchEvent::Type::Move) {
-                _dragOrHoldTimer.stop();
-                _holdTimer.stop();
-                float dist = distance(event, _startEvent);
-                if(dist >= 20) {
-                    Gesture drag;
-                    drag.type = Gestures::Drag;
-                    drag.drag = {
-                        .state = GestureState::Start,
-                        .x = resLerp(_startEvent.x, _resolutionX, _expectedX),
-                        .y = resLerp(_startEvent.y, _resolutionY, _expectedY),
-                        .dx = 0,
-                        .dy = 0
-                    };
-                    _recognizer.pushGesture(drag);
-                    _state = DragOngoing;
-                }   
-            }
-        } break;
-        case(DragOngoing): {
-            float dist = distance(event, _lastEvent);
-            if(event.type == TouchEvent::Type::Move) {
-                int dx = resLerp(event.x, _resolutionX, _expectedX) - resLerp(_lastEvent.x, _resolutionX, _expectedX);
-                int dy = resLerp(event.y, _resolutionY, _expectedY) - resLerp(_lastEvent.y, _resolutionY, _expectedY);
-                Gesture drag;
-                drag.type = Gestures::Drag;
-                drag.drag  = {
-                    .state = GestureState::Move,
-                    .x = resLerp(event.x, _resolutionX, _expectedX),
-                    .y = resLerp(event.y, _resolutionY, _expectedY),
-                    .dx = dx,
-                    .dy = dy
-                };
-                _recognizer.pushGesture(drag);
-            }
-        } break;
-        case(DoubleTapPossible): {
-            if(event.type == TouchEvent::Type::Move && event.id == _lastEvent.id) { 
-                if(_eventsHistory.size() < 5) break;
-
-                //check all 5 are move
-                bool skip = false;
-                std::size_t size = _eventsHistory.size();
-                for(int i=size-5; i<size; ++i) {
-                    if(_eventsHistory[i].type != TouchEvent::Type::Move) {
-                        skip = true;
-                        break;
-                    }
-                }
-
-                if(skip) break;
-
-                if (_eventsHistory.size() % 5 == 0) {
-                    //calc radius
-                    float aproxRad = 0.0f;
-                    {  
-                        bool skip = false;
-                        std::size_t size = _eventsHistory.size();
-                        if(size < 10) skip = true;
-
-                        if(!skip) {
-                            for(std::size_t s=size-10; s<size; ++s) {
-                                TouchEvent & t = _eventsHistory[s];
-                                aproxRad = std::sqrt(std::pow(t.x-_startEvent.x, 2)+std::pow(t.y-_startEvent.y, 2));
-                            }
-                            aproxRad /= 10;
-                            // std::cout << "aprox radius: " << aproxRad << std::endl;
-                        }
-                    }
-
-                    float deltaAngle = 0.0f;
-                    {//calc polar angle
-                        std::size_t size = _eventsHistory.size();
-                        float tmp = 0.0f;
-                        float tmp2 = 0.0f;
-                        for(std::size_t s=size-4; s<size; ++s) {
-                            TouchEvent &t = _eventsHistory[s];
-                            TouchEvent &t1 = _eventsHistory[s-1];
-                            tmp = std::atan2(t.y-_startEvent.y, t.x-_startEvent.x);
-                            tmp2 = std::atan2(t1.y-_startEvent.y, t1.x-_startEvent.x);
-                            float tmp3 = tmp - tmp2;
-                            deltaAngle += normalize_angle(tmp3);
-                        }
-                        std::cout << "angle rotation: " << deltaAngle << std::endl;
-                    }
-
-
-
-                    float turnSum = computeTurnAngleSum(_eventsHistory);
-                    // std::cout << "turnsum: " << turnSum << std::endl;
-                    float triqpi = M_PI * 0.95f;
-                    if (turnSum >= triqpi) {
-                        _doubleTapHelper = Circular;
-                    } else {
-                        _doubleTapHelper = Linear;
-                    }
-                    _predictions++;
-                }
-
-                if(_predictions >= 10) {
-                    if(_doubleTapHelper == Circular) {
-                        Gesture circ;
-                        circ.type = Gestures::DoubleTapCircular;
-                        circ.dtCircular = {
-                            .state = GestureState::Start,
-                            .x = resLerp(_startEvent.x, _resolutionX, _expectedX),
-                            .y = resLerp(_startEvent.y, _resolutionY, _expectedY),
-                            .dx = 0,
-                            .dy = 0,
-                            .angle = 0.f,
-                            .deltaAngle = 0.f,
-                            .radius = 0.f,
-                            .speed = 0.f
-                        };
-                        _recognizer.pushGesture(circ);
-
-                        _state = DoubleTapCircularOngoing;
-                    } else if(_doubleTapHelper == Linear) {
-                        Gesture swipe;
-                        swipe.type = Gestures::DoubleTapSwipe;
-                        swipe.dtSwipe = {
-                            .state = GestureState::Start,
-                            .x = resLerp(_startEvent.x, _resolutionX, _expectedX),
-                            .y = resLerp(_startEvent.y, _resolutionY, _expectedY),
-                            .dx = 0,
-                            .dy = 0
-                        };
-                        _recognizer.pushGesture(swipe);
-
-                        _state = DoubleTapSwipeOngoing;
-                    }
-                }
-            } else if(event.type == TouchEvent::Type::Begin && event.id != _lastEvent.id) {
-                std::cout << "Holly cow!" << std::endl;
-            }
-        } break;
-        case(DoubleTapSwipeOngoing): {
-            float dist = distance(event, _lastEvent);
-            if(event.type == TouchEvent::Type::Move && dist >= 2) {
-                int dx = resLerp(event.x, _resolutionX, _expectedX) - resLerp(_lastEvent.x, _resolutionX, _expectedX);
-                int dy = resLerp(event.y, _resolutionY, _expectedY) - resLerp(_lastEvent.y, _resolutionY, _expectedY);
-                Gesture swipe;
-                swipe.type = Gestures::DoubleTapSwipe;
-                swipe.dtSwipe = {
-                    .state = GestureState::Move,
-                    .x = resLerp(event.x, _resolutionX, _expectedX),
-                    .y = resLerp(event.y, _resolutionY, _expectedY),
-                    .dx = dx,
-                    .dy = dy
-                };
-                _recognizer.pushGesture(swipe);
-
-            }
-        } break;
-        case(DoubleTapCircularOngoing): {
-            float dist = distance(event, _lastEvent);
-            if(event.type == TouchEvent::Type::Move && dist > 2) {
-                
-                float anglePrev = getAngle(_lastEvent.x, _lastEvent.y, _startEvent.x, _startEvent.y);
-                float angleCurr = getAngle(event.x, event.y, _startEvent.x, _startEvent.y);
-                
-                float deltaAngle = angleCurr - anglePrev;
-                if (deltaAngle > M_PI) deltaAngle -= 2 * M_PI;
-                if (deltaAngle < -M_PI) deltaAngle += 2 * M_PI;
-
-                // _totalAngle += deltaAngle;
-
-                float dx = event.x - _startEvent.x;
-                float dy = event.y - _startEvent.y;
-                float radius = std::sqrt(dx*dx + dy*dy);
-
-                float dt = std::chrono::duration<float>(now - event.time).count();
-                float speed = deltaAngle / dt;
-
-                /*std::cout << "Double tap circular" << 
-                    " move angle: " << angleCurr << 
-                    " delta angle: " << deltaAngle << 
-                    " radius: " << radius << 
-                    " speed: " << speed << 
-                    " x: " << event.x << 
-                    " y: " << event.y << std::endl;*/
-                Gesture circ;
-                circ.type = Gestures::DoubleTapCircular;
-                circ.dtCircular = {
-                    .state = GestureState::Move,
-                    .x = resLerp(event.x, _resolutionX, _expectedX),
-                    .y = resLerp(event.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0,
-                    .angle = angleCurr,
-                    .deltaAngle = deltaAngle,
-                    .radius = radius,
-                    .speed = speed
-                };
-                _recognizer.pushGesture(circ);
-            }
-        } break;
-        case(SwipeOngoing): {
-            float dist = distance(event, _lastEvent);
-            if(event.type == TouchEvent::Type::Move && dist > 5) {
-                int dx = resLerp(event.x, _resolutionX, _expectedX) - resLerp(_lastEvent.x, _resolutionX, _expectedX);
-                int dy = resLerp(event.y, _resolutionY, _expectedY) - resLerp(_lastEvent.y, _resolutionY, _expectedY);
-                Gesture swipe;
-                swipe.type = Gestures::Swipe;
-                swipe.swipe = {
-                    .state = GestureState::Move,
-                    .x = resLerp(event.x, _resolutionX, _expectedX),
-                    .y = resLerp(event.y, _resolutionY, _expectedY),
-                    .dx = dx,
-                    .dy = dy
-                };
-                _recognizer.pushGesture(swipe);
-            } else if(event.type == TouchEvent::Type::End) {
-                Gesture swipe;
-                swipe.type = Gestures::Swipe;
-                swipe.swipe = {
-                    .state = GestureState::End,
-                    .x = resLerp(event.x, _resolutionX, _expectedX),
-                    .y = resLerp(event.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0
-                };
-                _recognizer.pushGesture(swipe);
-                
-                reset();
-            }
-        } break;
-        case(Hold): {
-            //do nothing
-            if(event.id != _startEvent.id) {
-                reset();
-            }
-        } break;
-        case(HoldOngoing): {
-            if(event.id != _startEvent.id) {
-                reset();
-            }
-
-            if(event.type == TouchEvent::Type::Move) {
-                int dx = resLerp(event.x, _resolutionX, _expectedX) - resLerp(_lastEvent.x, _resolutionX, _expectedX);
-                int dy = resLerp(event.y, _resolutionY, _expectedY) - resLerp(_lastEvent.y, _resolutionY, _expectedY);
-                
-                Gesture hold;
-                hold.type = Gestures::Hold;
-                hold.hold = {
-                    .state = GestureState::Move,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = dx,
-                    .dy = dy,
-                };
-                _recognizer.pushGesture(hold);
-            }
-        } break;
+void OneFingerFSM::transition(state to) {
+    if(to == Idle) {
+        reset();
+    } else {
+        setState(to);
     }
-    _lastEvent = event;
-    if(_eventsHistory.size() >= 35) {
-        _eventsHistory.pop_front();
+}
+
+bool OneFingerFSM::sameFinger(const TouchEvent & event, timePoint) {
+    return event.id == _startEvent.id;
+}
+
+bool OneFingerFSM::otherFinger(const TouchEvent & event, timePoint) {
+    return event.id != _startEvent.id;
+}
+
+bool OneFingerFSM::lastFinger(const TouchEvent & event, timePoint) {
+    return event.id == _lastEvent.id;
+}
+
+bool OneFingerFSM::notLastFinger(const TouchEvent & event, timePoint) {
+    return event.id != _lastEvent.id;
+}
+
+bool OneFingerFSM::begun(const TouchEvent & event, timePoint) {
+    return event.type == TouchEvent::Type::Begin;
+}
+
+bool OneFingerFSM::ended(const TouchEvent & event, timePoint) {
+    return event.type == TouchEvent::Type::End;
+}
+
+bool OneFingerFSM::afterMove(const TouchEvent &, timePoint) {
+    return _lastEvent.type == TouchEvent::Type::Move;
+}
+
+bool OneFingerFSM::notAfterMove(const TouchEvent &, timePoint) {
+    return _lastEvent.type != TouchEvent::Type::Move;
+}
+
+//Checked against time, resetOrProcess() may run much more often than input arrives (BusyPoll)
+bool OneFingerFSM::graceOver(const TouchEvent & event, timePoint now) {
+    return now - event.time >= std::chrono::milliseconds(_config->dragOrHoldGrace);
+}
+
+template<OneFingerFSM::timer OneFingerFSM::*T>
+bool OneFingerFSM::expired(const TouchEvent &, timePoint now) {
+    return timerExpired(this->*T, now);
+}
+
+//distances compared squared, no sqrt
+template<int RecognizerConfig::*Distance>
+bool OneFingerFSM::fromStartAtLeast(const TouchEvent & event, timePoint) {
+    int dx = event.x - _startEvent.x;
+    int dy = event.y - _startEvent.y;
+    int distance = _config->*Distance;
+    return dx * dx + dy * dy >= distance * distance;
+}
+
+template<int RecognizerConfig::*Distance>
+bool OneFingerFSM::fromLastAtLeast(const TouchEvent & event, timePoint) {
+    int dx = event.x - _lastEvent.x;
+    int dy = event.y - _lastEvent.y;
+    int distance = _config->*Distance;
+    return dx * dx + dy * dy >= distance * distance;
+}
+
+template<int RecognizerConfig::*Distance>
+bool OneFingerFSM::fromLastOver(const TouchEvent & event, timePoint) {
+    int dx = event.x - _lastEvent.x;
+    int dy = event.y - _lastEvent.y;
+    int distance = _config->*Distance;
+    return dx * dx + dy * dy > distance * distance;
+}
+
+template<OneFingerFSM::gestureMove Move>
+bool OneFingerFSM::decided(const TouchEvent &, timePoint) {
+    return _predictions >= _config->doubleTapPredictions && _doubleTapHelper == Move;
+}
+
+//position from the event, first touch or previous event; Delta adds movement since previous event
+template<Gestures Type, GestureState State, OneFingerFSM::At Where, bool Delta>
+void OneFingerFSM::emit(const TouchEvent & event, timePoint) {
+    const TouchEvent & at = Where == At::Start ? _startEvent : (Where == At::Last ? _lastEvent : event);
+    int x = resLerp(at.x, _resolutionX, _expectedX);
+    int y = resLerp(at.y, _resolutionY, _expectedY);
+    int dx = 0;
+    int dy = 0;
+    if constexpr(Delta) {
+        dx = resLerp(event.x, _resolutionX, _expectedX) - resLerp(_lastEvent.x, _resolutionX, _expectedX);
+        dy = resLerp(event.y, _resolutionY, _expectedY) - resLerp(_lastEvent.y, _resolutionY, _expectedY);
+    }
+
+    Gesture g;
+    g.type = Type;
+    if constexpr(Type == Gestures::TouchDown) {
+        g.touchDown = { .x = x, .y = y };
+    } else if constexpr(Type == Gestures::Tap) {
+        g.tap = { .x = x, .y = y };
+    } else if constexpr(Type == Gestures::DoubleTap) {
+        g.doubleTap = { .x = x, .y = y };
+    } else if constexpr(Type == Gestures::Hold) {
+        g.hold = { .state = State, .x = x, .y = y, .dx = dx, .dy = dy };
+    } else if constexpr(Type == Gestures::Swipe) {
+        g.swipe = { .state = State, .x = x, .y = y, .dx = dx, .dy = dy };
+    } else if constexpr(Type == Gestures::Drag) {
+        g.drag = { .state = State, .x = x, .y = y, .dx = dx, .dy = dy };
+    } else if constexpr(Type == Gestures::DoubleTapSwipe) {
+        g.dtSwipe = { .state = State, .x = x, .y = y, .dx = dx, .dy = dy };
+    } else if constexpr(Type == Gestures::DoubleTapCircular) {
+        g.dtCircular = {
+            .state = State,
+            .x = x,
+            .y = y,
+            .dx = 0,
+            .dy = 0,
+            .angle = 0.f,
+            .deltaAngle = 0.f,
+            .radius = 0.f,
+            .speed = 0.f
+        };
+    } else {
+        static_assert(Type != Type, "not a one finger gesture");
+    }
+    _recognizer.pushGesture(g, event.time);
+}
+
+template<OneFingerFSM::timer OneFingerFSM::*T, int RecognizerConfig::*Timeout>
+void OneFingerFSM::arm(const TouchEvent &, timePoint now) {
+    startTimer(this->*T, _config->*Timeout, now);
+}
+
+template<OneFingerFSM::timer OneFingerFSM::*T>
+void OneFingerFSM::disarm(const TouchEvent &, timePoint) {
+    (this->*T).stop();
+}
+
+void OneFingerFSM::remember(const TouchEvent & event, timePoint) {
+    _startEvent = event;
+}
+
+void OneFingerFSM::strayFinger(const TouchEvent &, timePoint) {
+    GESTLIB_DEBUG("FSM: another finger began during double tap");
+}
+
+//second touch is measured around the first one
+void OneFingerFSM::trackSecond(const TouchEvent & event, timePoint) {
+    _trajectory.reset(_startEvent.x, _startEvent.y);
+    _trajectory.add(event.x, event.y, event.time);
+}
+
+void OneFingerFSM::track(const TouchEvent & event, timePoint) {
+    _trajectory.add(event.x, event.y, event.time);
+}
+
+//every move votes, the same answer several times in a row decides (decided<>).
+//Turning a lot over Trajectory::TURN_WINDOW segments is a circle, unless the points lie on a straight line
+void OneFingerFSM::vote(const TouchEvent & event, timePoint) {
+    _trajectory.add(event.x, event.y, event.time);
+    if(!_trajectory.windowFull()) return;
+
+    gestureMove prediction = _trajectory.turnSum() >= _config->circularTurn ? Circular : Linear;
+    if(prediction == Circular) {
+        //slow straight moves turn a lot on sensor jitter alone, a line fit tells them apart
+        PointWindow window;
+        window.load(_eventsHistory.last<Trajectory::TURN_WINDOW + 1>());
+        window.add(event.x, event.y);
+        //points are touchscreen units, straightRms output pixels
+        float straightRms = _config->straightRms;
+        if(_expectedX > 0) straightRms = straightRms * _resolutionX / _expectedX;
+        if(fitLine(window).rms < straightRms) prediction = Linear;
     }
-    _eventsHistory.push_back(event);
-
-}
-
-int OneFingerFSM::resetOrProcess(/*std::vector<TouchEvent> & touches*/) {
-    // TouchEvent & event = touches[0];
-    timer::timePoint now = std::chrono::steady_clock::now();
-    // std::cout << "resetOrProc: ";
-    // printState(_state);
-
-    switch(_state) {
-        case(Idle): {
-            //do nothing
-            reset();
-            return 0;
-        } break;
-        case(Stroke): {
-            // if(touches.size() == 0) {
-                if(_lastEvent.type == TouchEvent::Type::Begin) {
-                    if(_holdTimer.active() && _holdTimer.expired(now)) {
-                        _state = Hold;
-                    }
-                } else if(_lastEvent.type == TouchEvent::Type::End) {
-                    if(_tapTimer.active() && _tapTimer.expired(now)) {
-                        Gesture tap;
-                        tap.type = Gestures::Tap;
-                        tap.tap = {
-                            .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                            .y = resLerp(_lastEvent.y, _resolutionY, _expectedY)
-                        };
-                        _recognizer.pushGesture(tap);
-                        reset();
-                    }
-                }
-            // }
-        } break;
-        case(DragOrHold): {
-            // ???
-            reset();
-        } break;
-        case(DragOngoing): {
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                Gesture drag;
-                drag.type = Gestures::Drag;
-                drag.drag = {
-                    .state = GestureState::End,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0
-                };
-                _recognizer.pushGesture(drag);
-
-                reset();
-            }
-        } break;
-        case(DoubleTapPossible): {
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                if(_doubleTapTimer.active() && _doubleTapTimer.expired(now)) {
-                    Gesture dtap;
-                    dtap.type = Gestures::DoubleTap;
-                    dtap.doubleTap = {
-                        .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                        .y = resLerp(_lastEvent.y, _resolutionY, _expectedY)
-                    };
-                    _recognizer.pushGesture(dtap);
-                    
-                    reset();
-                }
-            }
-        } break;
-        case(DoubleTapSwipeOngoing): {
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                Gesture swipe;
-                swipe.type = Gestures::DoubleTapSwipe;
-                swipe.dtSwipe = {
-                    .state = GestureState::End,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0
-                };
-                _recognizer.pushGesture(swipe);
-                
-                reset();
-            }
-        } break;
-        case(DoubleTapCircularOngoing): {
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                Gesture circ;
-                circ.type = Gestures::DoubleTapCircular;
-                circ.dtCircular = {
-                    .state = GestureState::End,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0,
-                    .angle = 0.f,
-                    .deltaAngle = 0.f,
-                    .radius = 0.f,
-                    .speed = 0.f
-                };
-                _recognizer.pushGesture(circ);
-                
-                reset();
-            }
-        } break;
-        case(SwipeOngoing): {
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                Gesture swipe;
-                swipe.type = Gestures::Swipe;
-                swipe.swipe = {
-                    .state = GestureState::End,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0
-                };
-                _recognizer.pushGesture(swipe);
-
-                reset();
-            }
-        } break;
-        case(Hold): {
-            if(_lastEvent.id != _startEvent.id) {
-                reset();
-            }
-
-            if(_lastEvent.type == TouchEvent::Type::Begin) {
-                Gesture hold;
-                hold.type = Gestures::Hold;
-                hold.hold = {
-                    .state = GestureState::Start,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0,
-                };
-                _recognizer.pushGesture(hold);
-                _state = HoldOngoing;
-            }
-        } break;
-        case(HoldOngoing): {
-            if(_lastEvent.id != _startEvent.id) {
-                reset();
-            }
-
-            if(_lastEvent.type == TouchEvent::Type::End) {
-                Gesture hold;
-                hold.type = Gestures::Hold;
-                hold.hold = {
-                    .state = GestureState::End,
-                    .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
-                    .y = resLerp(_lastEvent.y, _resolutionY, _expectedY),
-                    .dx = 0,
-                    .dy = 0,
-                };
-                _recognizer.pushGesture(hold);
-                reset();
-            }
-        } break;
+    GESTLIB_TRACE("turn sum: " << _trajectory.turnSum() << " rotation: " << _trajectory.rotation()
+                    << " mean radius: " << _trajectory.meanRadius());
+    if(prediction == _doubleTapHelper) {
+        _predictions++;
+    } else {
+        _doubleTapHelper = prediction;
+        _predictions = 1;
     }
+}
+
+//track() ran on this event already, so the trajectory's last step is the one from _lastEvent
+void OneFingerFSM::circularMove(const TouchEvent & event, timePoint) {
+    Gesture circ;
+    circ.type = Gestures::DoubleTapCircular;
+    circ.dtCircular = {
+        .state = GestureState::Move,
+        .x = resLerp(event.x, _resolutionX, _expectedX),
+        .y = resLerp(event.y, _resolutionY, _expectedY),
+        .dx = 0,
+        .dy = 0,
+        .angle = _trajectory.angle(),
+        .deltaAngle = _trajectory.deltaAngle(),
+        .radius = _trajectory.radius(),
+        .speed = _trajectory.angularVelocity()
+    };
+    _recognizer.pushGesture(circ, event.time);
+}
+
+//Rules of a state are tried top to bottom, first one that fires wins unless it says Continue
+struct OneFingerFSM::Rules {
+    using F = OneFingerFSM;
+    using C = RecognizerConfig;
+    using Table = FsmEngine<F, state, FSM_STATES, &F::transition,
+        Rule<Idle, FsmOn::Begin, Stroke, If<>,
+            Do<&F::remember, &F::arm<&F::_tapTimer, &C::tapTimeout>, &F::arm<&F::_dragOrHoldTimer, &C::dragOrHoldTimeout>, &F::arm<&F::_holdTimer, &C::holdTimeout>,
+                &F::emit<Gestures::TouchDown>>>,
+
+        //any further input of the finger and it's not a tap anymore
+        Rule<Stroke, FsmOn::Begin | FsmOn::Move, FsmNext::Continue, If<&F::sameFinger>, Do<&F::disarm<&F::_tapTimer>>>,
+        Rule<Stroke, FsmOn::Begin | FsmOn::Move, DragOrHold, If<&F::sameFinger, &F::notAfterMove, &F::expired<&F::_dragOrHoldTimer>>>,
+        Rule<Stroke, FsmOn::Begin | FsmOn::Move, SwipeOngoing, If<&F::sameFinger, &F::afterMove, &F::fromStartAtLeast<&C::swipeDistance>>,
+            Do<&F::emit<Gestures::Swipe, GestureState::Start, At::Start>>>,
+        Rule<Stroke, FsmOn::Begin, DoubleTapPossible, If<&F::otherFinger>, Do<&F::arm<&F::_doubleTapTimer, &C::doubleTapTimeout>, &F::trackSecond>>,
+        Rule<Stroke, FsmOn::Tick, Hold, If<&F::begun, &F::expired<&F::_holdTimer>>>,
+        Rule<Stroke, FsmOn::Tick, Idle, If<&F::ended, &F::expired<&F::_tapTimer>>, Do<&F::emit<Gestures::Tap>>>,
+
+        Rule<DragOrHold, FsmOn::Touch, Idle, If<&F::otherFinger>>,
+        Rule<DragOrHold, FsmOn::Move, FsmNext::Continue, If<>, Do<&F::disarm<&F::_dragOrHoldTimer>, &F::disarm<&F::_holdTimer>>>,
+        Rule<DragOrHold, FsmOn::Move, DragOngoing, If<&F::fromStartAtLeast<&C::dragDistance>>,
+            Do<&F::emit<Gestures::Drag, GestureState::Start, At::Start>>>,
+        //no movement within grace period, neither drag nor hold
+        Rule<DragOrHold, FsmOn::Tick, Idle, If<&F::graceOver>>,
+
+        Rule<DragOngoing, FsmOn::Move, FsmNext::Stay, If<>, Do<&F::emit<Gestures::Drag, GestureState::Move, At::Event, true>>>,
+        Rule<DragOngoing, FsmOn::Tick, Idle, If<&F::ended>, Do<&F::emit<Gestures::Drag, GestureState::End>>>,
+
+        Rule<DoubleTapPossible, FsmOn::Move, FsmNext::Continue, If<&F::lastFinger>, Do<&F::vote>>,
+        Rule<DoubleTapPossible, FsmOn::Move, DoubleTapCircularOngoing, If<&F::lastFinger, &F::decided<Circular>>,
+            Do<&F::emit<Gestures::DoubleTapCircular, GestureState::Start, At::Start>>>,
+        Rule<DoubleTapPossible, FsmOn::Move, DoubleTapSwipeOngoing, If<&F::lastFinger, &F::decided<Linear>>,
+            Do<&F::emit<Gestures::DoubleTapSwipe, GestureState::Start, At::Start>>>,
+        Rule<DoubleTapPossible, FsmOn::Begin, FsmNext::Stay, If<&F::notLastFinger>, Do<&F::strayFinger>>,
+        Rule<DoubleTapPossible, FsmOn::Tick, Idle, If<&F::ended, &F::expired<&F::_doubleTapTimer>>, Do<&F::emit<Gestures::DoubleTap>>>,
+
+        Rule<DoubleTapSwipeOngoing, FsmOn::Move, FsmNext::Stay, If<&F::fromLastAtLeast<&C::doubleTapSwipeStep>>,
+            Do<&F::emit<Gestures::DoubleTapSwipe, GestureState::Move, At::Event, true>>>,
+        Rule<DoubleTapSwipeOngoing, FsmOn::Tick, Idle, If<&F::ended>, Do<&F::emit<Gestures::DoubleTapSwipe, GestureState::End>>>,
+
+        Rule<DoubleTapCircularOngoing, FsmOn::Move, FsmNext::Continue, If<>, Do<&F::track>>,
+        Rule<DoubleTapCircularOngoing, FsmOn::Move, FsmNext::Stay, If<&F::fromLastOver<&C::circularStep>>, Do<&F::circularMove>>,
+        Rule<DoubleTapCircularOngoing, FsmOn::Tick, Idle, If<&F::ended>, Do<&F::emit<Gestures::DoubleTapCircular, GestureState::End>>>,
+
+        Rule<SwipeOngoing, FsmOn::Move, FsmNext::Stay, If<&F::fromLastOver<&C::swipeStep>>,
+            Do<&F::emit<Gestures::Swipe, GestureState::Move, At::Event, true>>>,
+        Rule<SwipeOngoing, FsmOn::End | FsmOn::Tick, Idle, If<&F::ended>, Do<&F::emit<Gestures::Swipe, GestureState::End>>>,
+
+        Rule<Hold, FsmOn::Touch | FsmOn::Tick, Idle, If<&F::otherFinger>>,
+        Rule<Hold, FsmOn::Tick, HoldOngoing, If<&F::begun>, Do<&F::emit<Gestures::Hold, GestureState::Start>>>,
+
+        Rule<HoldOngoing, FsmOn::Touch | FsmOn::Tick, Idle, If<&F::otherFinger>>,
+        Rule<HoldOngoing, FsmOn::Move, FsmNext::Stay, If<>, Do<&F::emit<Gestures::Hold, GestureState::Move, At::Last, true>>>,
+        Rule<HoldOngoing, FsmOn::Tick, Idle, If<&F::ended>, Do<&F::emit<Gestures::Hold, GestureState::End>>>
+    >;
+};
+
+void OneFingerFSM::process(std::vector<TouchEvent> & touches) {
+    TouchEvent & event = touches[0];
+    //Begin/Move/End are FsmOn bits 0/1/2
+    unsigned input = 1u << static_cast<unsigned>(event.type);
+    //timers run on input time, so polling jitter doesn't change tap/hold decisions
+    Rules::Table::dispatch(*this, _state, input, event, event.time);
+    _lastEvent = event;
+    _eventsHistory.push(event);
+}
 
+int OneFingerFSM::resetOrProcess(timePoint now) {
+    if(_state == Idle) return 0;
+    Rules::Table::dispatch(*this, _state, FsmOn::Tick, _lastEvent, now);
     return 1;
 }
 
@@ -601,9 +387,41 @@ void OneFingerFSM::reset() {
             .x = resLerp(_lastEvent.x, _resolutionX, _expectedX), 
             .y = resLerp(_lastEvent.y, _resolutionY, _expectedY)
         };
-        _recognizer.pushGesture(touch);
+        _recognizer.pushGesture(touch, _lastEvent.time);
     }
-    _state = Idle;
+    setState(Idle);
+}
+
+//earliest moment resetOrProcess() may do something; input driven transitions don't need it
+bool OneFingerFSM::nextDeadline(timer::timePoint now, timer::timePoint & deadline) {
+    //resetOrProcess() finishes these on the very next call
+    bool endPending = _lastEvent.type == TouchEvent::Type::End &&
+                        (_state == DragOngoing || _state == DoubleTapSwipeOngoing ||
+                        _state == DoubleTapCircularOngoing || _state == SwipeOngoing || _state == HoldOngoing);
+    bool holdPending = _state == Hold && _lastEvent.type == TouchEvent::Type::Begin;
+    if(endPending || holdPending) {
+        deadline = now;
+        return true;
+    }
+
+    //only what a Tick of this state acts on: a timer that ran out without that (tap timer while finger is
+    //still down) would keep reporting a passed deadline
+    timer::timePoint at;
+    if(_state == Stroke && _lastEvent.type == TouchEvent::Type::Begin && _holdTimer.active()) {
+        at = _holdTimer.deadline();
+    } else if(_state == Stroke && _lastEvent.type == TouchEvent::Type::End && _tapTimer.active()) {
+        at = _tapTimer.deadline();
+    } else if(_state == DragOrHold) {
+        //gives up unless movement follows shortly, used to be one poll tick
+        at = _lastEvent.time + std::chrono::milliseconds(_config->dragOrHoldGrace);
+    } else if(_state == DoubleTapPossible && _lastEvent.type == TouchEvent::Type::End && _doubleTapTimer.active()) {
+        at = _doubleTapTimer.deadline();
+    } else {
+        return false;
+    }
+    //already passed (input handled late): due right away, not never
+    deadline = std::max(at, now);
+    return true;
 }
 
 void OneFingerFSM::timer::start(int timeout, timePoint & now) {
@@ -617,8 +435,13 @@ void OneFingerFSM::timer::stop() {
     _timeout = 0;
 }
 
+OneFingerFSM::timer::timePoint OneFingerFSM::timer::deadline() const {
+    return _startTime + std::chrono::milliseconds(_timeout);
+}
+
+//now before start (caller supplied time, pump()) is not expired
 bool OneFingerFSM::timer::expired(timePoint & now) {
-    uint dur = std::chrono::duration_cast<std::chrono::milliseconds>(now - _startTime).count();
+    auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(now - _startTime).count();
     if(dur >= _timeout){  
         return true;  
     } else {  
@@ -2,39 +2,73 @@
 // Licensed under the MIT License. See LICENSE file in the project root for details.
 
 #include "gestlib/TouchDriver.h"
+#include "gestlib/Log.h"
+#include "gestlib/Probes.h"
 
 #include <libevdev/libevdev.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h> //close(fd)
 #include <fcntl.h> //open() O_RDONLY
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/utsname.h>
 #include <cstring> //strerror()
+#include <ctime> //CLOCK_MONOTONIC
 #include <iostream>
 #include <cmath>
 #include <algorithm>
 
 #include <fstream>
+#include <sstream>
 
 namespace GestLib {
 
-constexpr auto IDLE_THRESHOLD = std::chrono::milliseconds(250);
-constexpr auto PROBATION_THRESHOLD = std::chrono::milliseconds(50);
-constexpr auto ACTIVE_TO_LOST = std::chrono::milliseconds(50);
-constexpr auto LOST_TIMEOUT = std::chrono::milliseconds(50);
-constexpr int ACTIVATION_COUNT = 4;
+//gestlib:finger probe state of a finger that is gone
+constexpr int FINGER_REMOVED = -1;
+constexpr std::size_t READ_BATCH = 256; //input_events per read() for Batched engine
 
 TouchDriver::TouchDriver(int maxFingers) :
     _maxFingers(maxFingers),
     _fd(-1),
     _dev(nullptr),
+    _engine(IoEngine::Libevdev),
+    _type(DriverType::Real),
+    _info{},
+    _capturing(false),
+    _replayMap(nullptr),
+    _replaySize(0),
+    _replayOwned(false),
+    _replayCur(nullptr),
+    _replayEnd(nullptr),
+    _replayRealtime(true),
+    _replayStarted(false),
+    _replayOffset(0),
+    _virtualNow(std::chrono::time_point<std::chrono::steady_clock>()),
+    _replayEofAt(std::chrono::time_point<std::chrono::steady_clock>()),
+    _replayEof(false),
+    _inotifyFd(-1),
+    _vendor(0),
+    _product(0),
+    _evHead(0),
+    _evTail(0),
+    _skipToReport(false),
+    _kernelClock(false),
+    _resync(false),
+    _droppedCount(0),
     _resX(0),
     _resY(0),
     _currentSlot(0),
     _raw(maxFingers),
-    _currentFrameFingers(maxFingers),
+    _slotFinger(maxFingers, -1),
+    //lost fingers may still wait for their timeout while new ones already arrived
+    _logicalFingers(maxFingers * 2),
     _internalIdCounter(0)
 {
-    _logicalFingers.reserve(maxFingers);
+    _evBuf.resize(READ_BATCH);
 }
 
 TouchDriver::~TouchDriver() {
@@ -42,124 +76,579 @@ TouchDriver::~TouchDriver() {
 }
 
 bool TouchDriver::shutdown() {
+    stopCapture();
     if(_dev != nullptr) {
         libevdev_grab(_dev, LIBEVDEV_UNGRAB);
         libevdev_free(_dev);
         _dev = nullptr;
     }
+    if(_replayMap != nullptr) {
+        if(_replayOwned) munmap(const_cast<unsigned char*>(_replayMap), _replaySize);
+        _replayMap = nullptr;
+    }
     if(_fd >= 0) {
         close(_fd);
-        _fd = 0;
+        _fd = -1;
+    }
+    if(_inotifyFd >= 0) {
+        close(_inotifyFd);
+        _inotifyFd = -1;
     }
     return true;
 }
 
-std::vector<TouchEvent> TouchDriver::getEvents() {
+bool TouchDriver::lockMemory() {
+    bool ok = mlock(_evBuf.data(), _evBuf.size() * sizeof(input_event)) == 0;
+    ok = mlock(_raw.data(), _raw.size() * sizeof(RawFinger)) == 0 && ok;
+    ok = mlock(_logicalFingers.data(), _logicalFingers.size() * sizeof(LogicalFinger)) == 0 && ok;
+    //caller's buffer is caller's business
+    if(_replayMap != nullptr && _replayOwned) ok = mlock(_replayMap, _replaySize) == 0 && ok;
+    return ok;
+}
+
+std::chrono::time_point<std::chrono::steady_clock> TouchDriver::now() const {
+    if(_type == DriverType::Fake && !_replayRealtime) {
+        //after the end capture time just keeps running so pending timeouts still fire
+        if(_replayEof.load(std::memory_order_acquire)) {
+            return _virtualNow.load(std::memory_order_relaxed) + (std::chrono::steady_clock::now() - _replayEofAt.load(std::memory_order_relaxed));
+        }
+        return _virtualNow.load(std::memory_order_relaxed);
+    }
+    return std::chrono::steady_clock::now();
+}
+
+DriverStats TouchDriver::stats() const {
+    DriverStats s;
+    s.frames = _framesRead.load(std::memory_order_relaxed);
+    s.events = _eventsRead.load(std::memory_order_relaxed);
+    s.syscalls = _syscalls.load(std::memory_order_relaxed);
+    s.libevdevCalls = _libevdevCalls.load(std::memory_order_relaxed);
+    s.synDropped = _droppedCount.load(std::memory_order_relaxed);
+    s.fingersCreated = _fingersCreated.load(std::memory_order_relaxed);
+    s.fingersPromoted = _fingersPromoted.load(std::memory_order_relaxed);
+    s.fingersDiscarded = _fingersDiscarded.load(std::memory_order_relaxed);
+    s.contactsDropped = _contactsDropped.load(std::memory_order_relaxed);
+    return s;
+}
+
+bool TouchDriver::getEvents(std::vector<TouchEvent> & events) {
     bool data = readData();
-    return process(data);
+    process(data, events);
+    return data;
 }
 
-bool TouchDriver::readData() {      
+bool TouchDriver::getFrame(std::vector<TouchEvent> & events) {
+    if(!readData()) return false;
+    process(true, events);
+    return true;
+}
+
+bool TouchDriver::readData() {
+    if(_type == DriverType::Fake) {
+        return readReplay();
+    }
+    if(_fd < 0) {
+        //detached, waiting for hot-plug
+        return false;
+    }
+    if(_engine == IoEngine::Batched) {
+        return readBatched();
+    }
+    return readLibevdev();
+}
+
+bool TouchDriver::readLibevdev() {
     bool reading = true;
     bool newData = false;
 
-    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
     while(reading) {
 
         struct input_event ev;
         int rc = libevdev_next_event(_dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
+        bump(_libevdevCalls);
 
         if(rc == LIBEVDEV_READ_STATUS_SUCCESS) {
-            switch(ev.type) {
-                case(EV_ABS): {
-                    switch(ev.code) {
-                        case(ABS_MT_SLOT): _currentSlot = ev.value; break;
-                        case(ABS_MT_TRACKING_ID): {
-                            if(ev.value == -1) {
-                                if(_raw[_currentSlot].active) {
-                                    _raw[_currentSlot].active = false;
-                                }
-                            } else {
-                                _raw[_currentSlot].trackId = ev.value;
-                                _raw[_currentSlot].active = true;
-                            }
-                        } break;
-                        case(ABS_MT_POSITION_X): {
-                            _raw[_currentSlot].x = ev.value;
-                        } break;
-                        case(ABS_MT_POSITION_Y): {
-                            _raw[_currentSlot].y = ev.value;
-                        } break;
-                        case(ABS_MT_TOUCH_MAJOR): {
-                            _raw[_currentSlot].touchMajor = ev.value;
-                        } break;
-                        case(ABS_MT_TOUCH_MINOR): {
-                            _raw[_currentSlot].touchMinor = ev.value;
-                        } break;
-                    }
-                } break;
-
-                case(EV_SYN): {
-                    if(ev.code == SYN_REPORT) {
-                        _raw[_currentSlot].lastAction = now;
-                        reading = false;
-                        newData = true;
-                    }
-                } break;
+            if(decodeEvent(ev)) {
+                reading = false;
+                newData = true;
             }
         } else if(rc == -EAGAIN) { 
             //no events
             reading = false;
+        } else if(rc == -ENODEV) {
+            detach();
+            reading = false;
+            newData = true;
         } else if(rc == LIBEVDEV_READ_STATUS_SYNC &&
                     ev.type == EV_SYN && ev.code == SYN_DROPPED) {
-            
-            /* TODO: still didn't understood how this work. */
-            std::cerr << "SYN_DROPPED" << std::endl;
-            reading = false;
-            while (libevdev_next_event(_dev, LIBEVDEV_READ_FLAG_SYNC, &ev) == LIBEVDEV_READ_STATUS_SYNC) {
-                //restore devices actual state
-                
+            GESTLIB_DEBUG("SYN_DROPPED, resyncing through libevdev");
+            _droppedCount.fetch_add(1, std::memory_order_relaxed);
+            GESTLIB_PROBE(syn_dropped, _droppedCount.load(std::memory_order_relaxed));
+            if(_capturing) record(ev);
+
+            //libevdev replays the difference between what we've seen and actual device state
+            while(libevdev_next_event(_dev, LIBEVDEV_READ_FLAG_SYNC, &ev) == LIBEVDEV_READ_STATUS_SYNC) {
+                bump(_libevdevCalls);
+                decodeEvent(ev);
+            }
+            _frameTime = std::chrono::steady_clock::now();
+            for(auto & raw : _raw) {
+                if(raw.active) raw.lastAction = _frameTime;
             }
+            _resync = true;
+            reading = false;
+            newData = true;
         }
     }
 
     return newData;
 }
 
-std::vector<TouchEvent> TouchDriver::process(bool newData) {
-    std::vector<TouchEvent> ret;
-    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
-    
-    if(newData) {
-        _currentFrameFingers.clear();
-        for(const auto & raw : _raw) {
-            if(raw.active) {
-                _currentFrameFingers.push_back(raw);
+bool TouchDriver::readBatched() {
+    while(true) {
+        if(_evHead == _evTail) {
+            //one syscall for everything kernel has queued (up to buffer size)
+            ssize_t rc = read(_fd, _evBuf.data(), _evBuf.size() * sizeof(input_event));
+            bump(_syscalls);
+            if(rc < 0) {
+                if(errno == ENODEV) {
+                    detach();
+                    return true;
+                }
+                if(errno != EAGAIN) {
+                    GESTLIB_WARN("Touch device read failed: " << strerror(errno));
+                }
+                return false;
+            }
+            _evHead = 0;
+            _evTail = rc / sizeof(input_event);
+            if(_evTail == 0) return false;
+        }
+
+        while(_evHead < _evTail) {
+            const input_event & ev = _evBuf[_evHead++];
+
+            if(ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+                //kernel queue overflowed, everything up to next SYN_REPORT is garbage
+                GESTLIB_DEBUG("SYN_DROPPED, resyncing from kernel");
+                _droppedCount.fetch_add(1, std::memory_order_relaxed);
+                GESTLIB_PROBE(syn_dropped, _droppedCount.load(std::memory_order_relaxed));
+                _skipToReport = true;
+                continue;
             }
+
+            if(_skipToReport) {
+                if(ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                    _skipToReport = false;
+                    //state in _raw is unknown now, take it from kernel directly
+                    if(resyncFromKernel()) {
+                        return true;
+                    }
+                }
+                continue;
+            }
+
+            if(decodeEvent(ev)) {
+                //rest of the buffer stays for next call, see pending()
+                return true;
+            }
+        }
+    }
+}
+
+bool TouchDriver::resyncFromKernel() {
+    //EVIOCGMTSLOTS wants {code, values[slots]}
+    static constexpr int codes[] = {ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y,
+                                    ABS_MT_TOUCH_MAJOR, ABS_MT_TOUCH_MINOR};
+    std::size_t slots = _slotQuery.size() - 1;
+
+    for(int code : codes) {
+        _slotQuery[0] = code;
+        bump(_syscalls);
+        if(ioctl(_fd, EVIOCGMTSLOTS(_slotQuery.size() * sizeof(int32_t)), _slotQuery.data()) < 0) {
+            if(code == ABS_MT_TOUCH_MAJOR || code == ABS_MT_TOUCH_MINOR) continue; //optional
+            std::cerr << "EVIOCGMTSLOTS failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        for(std::size_t slot = 0; slot < slots && slot < _raw.size(); ++slot) {
+            int32_t value = _slotQuery[slot + 1];
+            RawFinger & raw = _raw[slot];
+            switch(code) {
+                case(ABS_MT_TRACKING_ID): {
+                    raw.active = value != -1;
+                    if(raw.active) raw.trackId = value;
+                } break;
+                case(ABS_MT_POSITION_X): raw.x = value; break;
+                case(ABS_MT_POSITION_Y): raw.y = value; break;
+                case(ABS_MT_TOUCH_MAJOR): raw.touchMajor = value; break;
+                case(ABS_MT_TOUCH_MINOR): raw.touchMinor = value; break;
+            }
+        }
+    }
+
+    struct input_absinfo slotInfo;
+    bump(_syscalls);
+    if(ioctl(_fd, EVIOCGABS(ABS_MT_SLOT), &slotInfo) == 0) {
+        _currentSlot = slotInfo.value;
+    }
+
+    _frameTime = std::chrono::steady_clock::now();
+    for(auto & raw : _raw) {
+        if(raw.active) raw.lastAction = _frameTime;
+    }
+    _resync = true;
+    //kernel state never went through decodeEvent(), write it down as events
+    if(_capturing) recordState();
+    return true;
+}
+
+bool TouchDriver::readReplay() {
+    if(_replayRealtime) {
+        uint64_t expirations;
+        read(_fd, &expirations, sizeof(expirations)); //rearm below, EAGAIN is fine
+        bump(_syscalls);
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> steadyNow = std::chrono::steady_clock::now();
+    if(!_replayStarted) {
+        _replayStarted = true;
+        if(_replayCur < _replayEnd) {
+            //first recorded event happens right now
+            _replayOffset = steadyNow.time_since_epoch() - std::chrono::microseconds(_replayCur->timeUs);
+        }
+    }
+
+    while(_replayCur < _replayEnd) {
+        const CaptureRecord & rec = *_replayCur;
+        std::chrono::time_point<std::chrono::steady_clock> time(std::chrono::microseconds(rec.timeUs) + _replayOffset);
+
+        if(_replayRealtime && time > steadyNow) {
+            armReplayTimer(time);
+            return false;
+        }
+        ++_replayCur;
+
+        if(rec.type == EV_SYN && rec.code == SYN_DROPPED) {
+            //recorded state after overflow follows
+            _droppedCount.fetch_add(1, std::memory_order_relaxed);
+            GESTLIB_PROBE(syn_dropped, _droppedCount.load(std::memory_order_relaxed));
+            _resync = true;
+            if(_capturing) {
+                CaptureRecord dropped = rec;
+                dropped.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+                writeRecord(dropped);
+            }
+            continue;
+        }
+
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+        struct input_event ev = {};
+        ev.input_event_sec = us / 1000000;
+        ev.input_event_usec = us % 1000000;
+        ev.type = rec.type;
+        ev.code = rec.code;
+        ev.value = rec.value;
+
+        if(decodeEvent(ev)) {
+            _virtualNow.store(_frameTime, std::memory_order_relaxed);
+            if(_replayRealtime && _replayCur < _replayEnd) {
+                //fires immediately if next frame is already late
+                armReplayTimer(std::chrono::time_point<std::chrono::steady_clock>(
+                    std::chrono::microseconds(_replayCur->timeUs) + _replayOffset));
+            }
+            return true;
+        }
+    }
+
+    finishReplay();
+    return false;
+}
+
+void TouchDriver::armReplayTimer(std::chrono::time_point<std::chrono::steady_clock> at) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count();
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+        spec.it_value.tv_nsec = 1; //zero would disarm
+    }
+    timerfd_settime(_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void TouchDriver::finishReplay() {
+    if(_replayEof.load(std::memory_order_relaxed)) return;
+    _replayEofAt.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+    _replayEof.store(true, std::memory_order_release);
+
+    if(_replayRealtime) {
+        struct itimerspec spec = {};
+        timerfd_settime(_fd, 0, &spec, nullptr);
+    } else {
+        uint64_t value;
+        read(_fd, &value, sizeof(value)); //eventfd is not readable anymore
+    }
+    GESTLIB_INFO("Replay finished: " << _path);
+}
+
+bool TouchDriver::initReplay(const std::string & path, bool realtime) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "Failed to open capture " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat fileinfo;
+    if(fstat(fd, &fileinfo) < 0 || fileinfo.st_size < static_cast<off_t>(sizeof(CaptureHeader))) {
+        std::cerr << "Not a capture file: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void * map = mmap(nullptr, fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //mapping keeps the file
+    if(map == MAP_FAILED) {
+        std::cerr << "Failed to map capture " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    madvise(map, fileinfo.st_size, MADV_SEQUENTIAL);
+
+    _replayOwned = true;
+    if(!startReplay(map, fileinfo.st_size, path, realtime)) {
+        //once taken over, shutdown() already unmapped it
+        if(_replayMap != map) munmap(map, fileinfo.st_size);
+        return false;
+    }
+    return true;
+}
+
+bool TouchDriver::initReplayBuffer(const void * data, std::size_t size, bool realtime) {
+    if(size < sizeof(CaptureHeader)) {
+        std::cerr << "Not a capture buffer" << std::endl;
+        return false;
+    }
+    _replayOwned = false;
+    return startReplay(data, size, "memory", realtime);
+}
+
+bool TouchDriver::startReplay(const void * data, std::size_t size, const std::string & name, bool realtime) {
+    const CaptureHeader * header = static_cast<const CaptureHeader*>(data);
+    if(header->magic != CAPTURE_MAGIC || header->version != CAPTURE_VERSION) {
+        std::cerr << "Unsupported capture format: " << name << std::endl;
+        return false;
+    }
+
+    _replayMap = static_cast<const unsigned char*>(data);
+    _replaySize = size;
+    _replayCur = reinterpret_cast<const CaptureRecord*>(_replayMap + sizeof(CaptureHeader));
+    _replayEnd = _replayCur + (_replaySize - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+    _replayRealtime = realtime;
+    _replayStarted = false;
+    _replayEof = false;
+
+    _info = *header;
+    _uniq = std::string(header->uniq, strnlen(header->uniq, sizeof(header->uniq)));
+    _path = name;
+    _resX = header->x.maximum;
+    _resY = header->y.maximum;
+    _slotQuery.resize(1 + header->slots);
+    _type = DriverType::Fake;
+    _kernelClock = true; //recorded times are already CLOCK_MONOTONIC
+
+    if(realtime) {
+        _fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(_fd >= 0) armReplayTimer(std::chrono::steady_clock::now());
+    } else {
+        //always readable until the end of capture
+        _fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    if(_fd < 0) {
+        std::cerr << "Failed to create replay fd: " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    return true;
+}
+
+bool TouchDriver::startCapture(const std::string & path) {
+    _capture.open(path, std::ios::binary | std::ios::trunc);
+    if(!_capture) {
+        std::cerr << "Failed to open capture file " << path << std::endl;
+        return false;
+    }
+    _capture.write(reinterpret_cast<const char*>(&_info), sizeof(_info));
+    _capturing = true;
+    return true;
+}
+
+void TouchDriver::stopCapture() {
+    if(!_capturing) return;
+    _capturing = false;
+    _capture.close();
+}
+
+void TouchDriver::record(const input_event & ev) {
+    writeRecord({
+        .timeUs = static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec,
+        .type = ev.type,
+        .code = ev.code,
+        .value = ev.value
+    });
+}
+
+void TouchDriver::writeRecord(const CaptureRecord & rec) {
+    _capture.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+}
+
+//overflow marker followed by whole slot state, so replay can rebuild what kernel told us
+void TouchDriver::recordState() {
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(_frameTime.time_since_epoch()).count();
+    auto put = [&](uint16_t type, uint16_t code, int32_t value) {
+        writeRecord({ .timeUs = us, .type = type, .code = code, .value = value });
+    };
+
+    put(EV_SYN, SYN_DROPPED, 0);
+    for(std::size_t slot = 0; slot < _raw.size(); ++slot) {
+        const RawFinger & raw = _raw[slot];
+        put(EV_ABS, ABS_MT_SLOT, slot);
+        put(EV_ABS, ABS_MT_TRACKING_ID, raw.active ? raw.trackId : -1);
+        put(EV_ABS, ABS_MT_POSITION_X, raw.x);
+        put(EV_ABS, ABS_MT_POSITION_Y, raw.y);
+        put(EV_ABS, ABS_MT_TOUCH_MAJOR, raw.touchMajor);
+        put(EV_ABS, ABS_MT_TOUCH_MINOR, raw.touchMinor);
+    }
+    put(EV_ABS, ABS_MT_SLOT, _currentSlot);
+    put(EV_SYN, SYN_REPORT, 0);
+}
+
+bool TouchDriver::decodeEvent(const input_event & ev) {
+    if(_capturing) record(ev);
+    bump(_eventsRead);
+
+    switch(ev.type) {
+        case(EV_ABS): {
+            if(ev.code == ABS_MT_SLOT) {
+                _currentSlot = ev.value;
+                break;
+            }
+            //device may report more slots than we track
+            if(_currentSlot < 0 || _currentSlot >= static_cast<int>(_raw.size())) break;
+
+            switch(ev.code) {
+                case(ABS_MT_TRACKING_ID): {
+                    if(ev.value == -1) {
+                        if(_raw[_currentSlot].active) {
+                            _raw[_currentSlot].active = false;
+                        }
+                    } else {
+                        _raw[_currentSlot].trackId = ev.value;
+                        _raw[_currentSlot].active = true;
+                    }
+                } break;
+                case(ABS_MT_POSITION_X): {
+                    _raw[_currentSlot].x = ev.value;
+                } break;
+                case(ABS_MT_POSITION_Y): {
+                    _raw[_currentSlot].y = ev.value;
+                } break;
+                case(ABS_MT_TOUCH_MAJOR): {
+                    _raw[_currentSlot].touchMajor = ev.value;
+                } break;
+                case(ABS_MT_TOUCH_MINOR): {
+                    _raw[_currentSlot].touchMinor = ev.value;
+                } break;
+            }
+        } break;
+
+        case(EV_SYN): {
+            if(ev.code == SYN_REPORT) {
+                if(_kernelClock) {
+                    //CLOCK_MONOTONIC is what steady_clock uses on linux
+                    _frameTime = std::chrono::time_point<std::chrono::steady_clock>(
+                        std::chrono::seconds(ev.input_event_sec) + std::chrono::microseconds(ev.input_event_usec));
+                } else {
+                    _frameTime = std::chrono::steady_clock::now();
+                }
+                if(_currentSlot >= 0 && _currentSlot < static_cast<int>(_raw.size())) {
+                    _raw[_currentSlot].lastAction = _frameTime;
+                }
+                bump(_framesRead);
+                GESTLIB_PROBE(frame, std::chrono::duration_cast<std::chrono::nanoseconds>(_frameTime.time_since_epoch()).count(),
+                                _eventsRead.load(std::memory_order_relaxed));
+                return true;
+            }
+        } break;
+    }
+    return false;
+}
+
+void TouchDriver::applyEventMask() {
+    //ask kernel to not queue anything we don't decode
+    unsigned char absCodes[(ABS_CNT + 7) / 8] = {};
+    for(int code : {ABS_MT_SLOT, ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y,
+                    ABS_MT_TOUCH_MAJOR, ABS_MT_TOUCH_MINOR}) {
+        absCodes[code / 8] |= 1 << (code % 8);
+    }
+    unsigned char keyCodes[(KEY_CNT + 7) / 8] = {};
+    unsigned char mscCodes[(MSC_CNT + 7) / 8] = {};
+    unsigned char relCodes[(REL_CNT + 7) / 8] = {};
+
+    struct input_mask masks[] = {
+        { .type = EV_ABS, .codes_size = sizeof(absCodes), .codes_ptr = reinterpret_cast<uintptr_t>(absCodes) },
+        { .type = EV_KEY, .codes_size = sizeof(keyCodes), .codes_ptr = reinterpret_cast<uintptr_t>(keyCodes) },
+        { .type = EV_MSC, .codes_size = sizeof(mscCodes), .codes_ptr = reinterpret_cast<uintptr_t>(mscCodes) },
+        { .type = EV_REL, .codes_size = sizeof(relCodes), .codes_ptr = reinterpret_cast<uintptr_t>(relCodes) }
+    };
+
+    for(auto & mask : masks) {
+        if(ioctl(_fd, EVIOCSMASK, &mask) < 0) {
+            //kernels older than 4.4 don't know EVIOCSMASK, not fatal
+            std::cerr << "EVIOCSMASK failed: " << strerror(errno) << std::endl;
+            break;
         }
+    }
+}
 
+void TouchDriver::process(bool newData, std::vector<TouchEvent> & ret) {
+    //every finger gives at most one event per call, so after first call this never allocates
+    ret.clear();
+    if(ret.capacity() < _logicalFingers.size()) {
+        ret.reserve(_logicalFingers.size());
+    }
+    //frame is evaluated at the moment it was completed, not when we got to it
+    std::chrono::time_point<std::chrono::steady_clock> now = newData ? _frameTime : this->now();
+    const auto probationTime = std::chrono::milliseconds(_config->probationTime);
+    const auto activeToLost = std::chrono::milliseconds(_config->activeToLost);
+    const auto lostTimeout = std::chrono::milliseconds(_config->lostTimeout);
+    
+    if(newData) {
         for(auto & finger : _logicalFingers) {
             finger.updatedThisFrame = false;
         }
 
-        for(const auto & raw : _currentFrameFingers) {
+        for(std::size_t slot = 0; slot < _raw.size(); ++slot) {
+            const RawFinger & raw = _raw[slot];
+            if(!raw.active) continue;
+
             LogicalFinger * match = nullptr;
 
-            for(auto & finger : _logicalFingers) {
-                if(finger.lastTrackedId == raw.trackId) {
-                    match = &finger;
-                    break;
-                }
+            //protocol B keeps tracking id in its slot, so last owner of the slot is the only candidate
+            int owner = _slotFinger[slot];
+            if(owner >= 0 && _logicalFingers[owner].used &&
+                _logicalFingers[owner].lastTrackedId == raw.trackId) {
+                match = &_logicalFingers[owner];
             }
 
             if(!match) {
                 for(auto & finger : _logicalFingers) {
-                    if(finger.state == FingerState::Lost) {
+                    if(finger.used && finger.state == FingerState::Lost) {
                         int dx = finger.x - raw.x;
                         int dy = finger.y - raw.y;
 
-                        if(std::abs(dx) <= 30 && std::abs(dy) <= 30 &&
-                            std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) < LOST_TIMEOUT) {
+                        if(std::abs(dx) <= _config->trackingBox && std::abs(dy) <= _config->trackingBox &&
+                            std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) < lostTimeout) {
                             match = &finger;
                             break;
                         }
@@ -178,8 +667,22 @@ std::vector<TouchEvent> TouchDriver::process(bool newData) {
                 }
                 match->lastTrackedId = raw.trackId;
                 match->updatedThisFrame = true;
+                _slotFinger[slot] = static_cast<int>(match - _logicalFingers.data());
             } else {
-                _logicalFingers.push_back({
+                LogicalFinger * free = nullptr;
+                for(auto & finger : _logicalFingers) {
+                    if(!finger.used) {
+                        free = &finger;
+                        break;
+                    }
+                }
+                //table is full of dying fingers, pick this one up on next frame
+                if(!free) {
+                    bump(_contactsDropped);
+                    continue;
+                }
+
+                *free = {
                     .logicalId = _internalIdCounter++,
                     .lastTrackedId = raw.trackId,
                     .state = FingerState::Probation,
@@ -190,16 +693,27 @@ std::vector<TouchEvent> TouchDriver::process(bool newData) {
                     .activeCount = 0,
                     .updatedThisFrame = true,
                     .markToDelete = false,
+                    .used = true,
                     .lastAction = raw.lastAction
-                });
+                };
+                _slotFinger[slot] = static_cast<int>(free - _logicalFingers.data());
+                bump(_fingersCreated);
+                GESTLIB_PROBE(finger, free->logicalId, static_cast<int>(FingerState::Probation), free->x, free->y);
             }
         }
     }
 
+    if(newData && _resync) {
+        _resync = false;
+        reconcile(ret, now);
+    }
+
     for(auto& finger : _logicalFingers) {
+        if(!finger.used || finger.markToDelete) continue;
+
         if(finger.state == FingerState::Probation) {
-            bool test2 = std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) > PROBATION_THRESHOLD;
-            bool test3 = finger.activeCount > ACTIVATION_COUNT;
+            bool test2 = std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) > probationTime;
+            bool test3 = finger.activeCount > _config->activationCount;
             
             if(!test2 && test3) {
                 finger.state = FingerState::Active;
@@ -208,57 +722,135 @@ std::vector<TouchEvent> TouchDriver::process(bool newData) {
                     .id = finger.logicalId,
                     .type = TouchEvent::Type::Begin,
                     .x = finger.x,
-                    .y = finger.y
+                    .y = finger.y,
+                    .time = now
                 });
                 finger.updatedThisFrame = false;
                 finger.lastAction = now;
+                bump(_fingersPromoted);
+                GESTLIB_PROBE(finger, finger.logicalId, static_cast<int>(finger.state), finger.x, finger.y);
             } else if(test2 && !test3) {
                 finger.markToDelete = true;
+                bump(_fingersDiscarded);
+                GESTLIB_PROBE(finger, finger.logicalId, FINGER_REMOVED, finger.x, finger.y);
             }
         } else if(finger.state == FingerState::Lost) {
             if(finger.updatedThisFrame) {
                 finger.state = FingerState::Active;
+                GESTLIB_PROBE(finger, finger.logicalId, static_cast<int>(finger.state), finger.x, finger.y);
                 // probablyMove(finger, ret, now);
                 finger.updatedThisFrame = false;
                 finger.lastAction = now;
             } else {
-                if(std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) >= LOST_TIMEOUT) {
+                if(std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) >= lostTimeout) {
                     ret.push_back({
                         .id = finger.logicalId,
                         .type = TouchEvent::Type::End,
                         .x = finger.x,
-                        .y = finger.y
+                        .y = finger.y,
+                        .time = now
                     });
                     finger.markToDelete = true;
+                    GESTLIB_PROBE(finger, finger.logicalId, FINGER_REMOVED, finger.x, finger.y);
                 }
             }
         } else { // Active
             if(finger.updatedThisFrame) {
                 //move?
-                probablyMove(finger, ret);
+                probablyMove(finger, ret, now);
                 finger.updatedThisFrame = false;
                 finger.lastAction = now;
             } else {
-                if(std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) >= ACTIVE_TO_LOST) {
+                if(std::chrono::duration_cast<std::chrono::milliseconds>(now - finger.lastAction) >= activeToLost) {
                     finger.state = FingerState::Lost;
                     finger.lastAction = now;
+                    GESTLIB_PROBE(finger, finger.logicalId, static_cast<int>(finger.state), finger.x, finger.y);
                 }
             }
         }
     }
 
 
-    _logicalFingers.erase(std::remove_if(_logicalFingers.begin(), _logicalFingers.end(),
-        [&](const LogicalFinger& finger) {
-            return finger.markToDelete;
-    }), _logicalFingers.end());
+    for(auto & finger : _logicalFingers) {
+        if(finger.markToDelete) {
+            finger.used = false;
+            finger.markToDelete = false;
+        }
+    }
+}
 
-    return ret;
+//finger state timeouts in process(), passed ones are due now
+bool TouchDriver::nextDeadline(std::chrono::time_point<std::chrono::steady_clock> now,
+                                std::chrono::time_point<std::chrono::steady_clock> & deadline) const {
+    bool found = false;
+    for(const auto & finger : _logicalFingers) {
+        if(!finger.used) continue;
+
+        std::chrono::time_point<std::chrono::steady_clock> at;
+        if(finger.state == FingerState::Probation) {
+            //reported enough: process() promotes it, timing it out wouldn't change anything
+            if(finger.activeCount > _config->activationCount) continue;
+            //checked with '>' on whole milliseconds
+            at = finger.lastAction + std::chrono::milliseconds(_config->probationTime + 1);
+        } else if(finger.state == FingerState::Lost) {
+            at = finger.lastAction + std::chrono::milliseconds(_config->lostTimeout);
+        } else {
+            at = finger.lastAction + std::chrono::milliseconds(_config->activeToLost);
+        }
+
+        //already passed (frame handled late): due right away, not never
+        at = std::max(at, now);
+        if(!found || at < deadline) {
+            deadline = at;
+            found = true;
+        }
+    }
+    return found;
 }
 
-void TouchDriver::probablyMove(LogicalFinger & finger, std::vector<TouchEvent> & ret) {
-    float threshold_min = 2.0f;
-    float threshold_max = 30.0f;
+//after SYN_DROPPED _raw holds device's real state, so don't wait for timeouts:
+//fingers that are gone end right now, fingers that survived the overflow skip probation
+void TouchDriver::reconcile(std::vector<TouchEvent> & ret, std::chrono::time_point<std::chrono::steady_clock> now) {
+    for(auto & finger : _logicalFingers) {
+        if(!finger.used) continue;
+
+        if(!finger.updatedThisFrame) {
+            if(finger.state != FingerState::Probation) {
+                ret.push_back({
+                    .id = finger.logicalId,
+                    .type = TouchEvent::Type::End,
+                    .x = finger.x,
+                    .y = finger.y,
+                    .time = now
+                });
+            } else {
+                bump(_fingersDiscarded);
+            }
+            finger.markToDelete = true;
+            GESTLIB_PROBE(finger, finger.logicalId, FINGER_REMOVED, finger.x, finger.y);
+        } else if(finger.state == FingerState::Probation) {
+            finger.state = FingerState::Active;
+            bump(_fingersPromoted);
+            GESTLIB_PROBE(finger, finger.logicalId, static_cast<int>(finger.state), finger.x, finger.y);
+            ret.push_back({
+                .id = finger.logicalId,
+                .type = TouchEvent::Type::Begin,
+                .x = finger.x,
+                .y = finger.y,
+                .time = now
+            });
+            finger.updatedThisFrame = false;
+            finger.lastAction = now;
+        } else if(finger.state == FingerState::Lost) {
+            finger.state = FingerState::Active;
+            GESTLIB_PROBE(finger, finger.logicalId, static_cast<int>(finger.state), finger.x, finger.y);
+        }
+    }
+}
+
+void TouchDriver::probablyMove(LogicalFinger & finger, std::vector<TouchEvent> & ret, std::chrono::time_point<std::chrono::steady_clock> now) {
+    int threshold_min = _config->moveMin;
+    int threshold_max = _config->moveMax;
     
     int dx = finger.x - finger.lastX;
     int dy = finger.y - finger.lastY;
@@ -268,7 +860,8 @@ void TouchDriver::probablyMove(LogicalFinger & finger, std::vector<TouchEvent> &
             .id = finger.logicalId,
             .type = TouchEvent::Type::Move,
             .x = finger.x,
-            .y = finger.y
+            .y = finger.y,
+            .time = now
         });
         finger.lastX = finger.x;
         finger.lastY = finger.y;
@@ -276,79 +869,321 @@ void TouchDriver::probablyMove(LogicalFinger & finger, std::vector<TouchEvent> &
 }
 
 bool TouchDriver::init() {
+    bool found = scanDevices(false);
+
+    if(found) {
+        //device may be re-enumerated later (usb reset), watch for it to come back
+        _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(_inotifyFd >= 0 && inotify_add_watch(_inotifyFd, "/dev/input", IN_CREATE | IN_ATTRIB) < 0) {
+            std::cerr << "Failed to watch /dev/input, hot-plug disabled: " << strerror(errno) << std::endl;
+            close(_inotifyFd);
+            _inotifyFd = -1;
+        }
+    }
+
+    return found;
+}
+
+//sameDevice: only accept device with identity we had before (re-attach after hot-plug)
+bool TouchDriver::scanDevices(bool sameDevice) {
+    if(!sameDevice && loadDeviceCache()) {
+        return true;
+    }
+
     bool found = false;
-    //look for touchscreens
-    DIR *ent = opendir("/dev/input");
-    std::string path = "/dev/input/";
-    std::size_t lastSlash = 11;
-            
+    //sysfs tells capabilities without opening (and grabbing) every node
+    DIR *ent = opendir("/sys/class/input");
     if(ent) {
-        errno = 0;
         struct dirent *entry = nullptr;
-        while(entry = readdir(ent)) {
+        while((entry = readdir(ent))) {
             std::string name = std::string(entry->d_name);
-            if(name.find("event") != std::string::npos) {
-                path = path.substr(0, lastSlash).append(name);
-                        
-                struct stat fileinfo;
-                int err = stat(path.c_str(), &fileinfo);
+            if(name.compare(0, 5, "event") != 0) continue;
 
+            std::string sys = "/sys/class/input/" + name + "/device/";
+            if(!sysfsIsMultitouch(sys)) continue;
+            if(sameDevice && !sysfsSameIdentity(sys)) continue;
 
-                if(err) {
-                    std::cerr << "No suitable touchscreen found" << std::endl;
-                    break;
-                }
+            if(tryOpen("/dev/input/" + name, sameDevice)) {
+                found = true;
+                break;
+            }
+        }
+        closedir(ent);
+    } else {
+        found = scanDevNodes(sameDevice);
+    }
 
-                if(S_ISCHR(fileinfo.st_mode)) {
-                    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-                    if(fd >= 0) {
-                        libevdev * dev = nullptr;
-                        int rc = libevdev_new_from_fd(fd, &dev);
-                        if(rc<0) {
-                            std::cerr << "Failed to init libevdev" << std::endl;
-                        }
+    if(found) {
+        saveDeviceCache();
+    } else if(!sameDevice) {
+        std::cerr << "No suitable touchscreen found" << std::endl;
+    }
+    return found;
+}
 
-                        //TODO: if app terminates unexpectedly(crash or smth) than regular input won't be restored...?
-                        rc = libevdev_grab(dev, LIBEVDEV_GRAB);
-                        if(rc < 0) {
-                            //sudo usermod -a -G input $USER
-                            std::cerr << "no permisions. Try running with sudo or adding your user to the 'input' group.\n" << std::endl;
-                        }
-                        bool res = libevdev_has_event_code(dev, EV_ABS, ABS_MT_SLOT) &&
-                                        libevdev_has_event_code(dev, EV_ABS, ABS_MT_TRACKING_ID) &&
-                                        libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_X)  &&
-                                        libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_Y);
-                            
-                        if(res) {
-                            _fd = fd;
-                            _dev = dev;
-                            _uniq = std::string(libevdev_get_uniq(dev));
-                            _path = path;
-                            found = true;
-
-                            //get resolution
-                            const struct input_absinfo* info = libevdev_get_abs_info(dev, ABS_MT_POSITION_X);
-                            _resX = info->maximum;
-                            info = libevdev_get_abs_info(dev, ABS_MT_POSITION_Y);
-                            _resY = info->maximum;
-                            break;
-                        } else {
-                            libevdev_free(dev);
-                            close(fd);
-                            continue;
-                        }
-                    }
-                }
+//no sysfs (containers and such): open each node and ask libevdev
+bool TouchDriver::scanDevNodes(bool sameDevice) {
+    bool found = false;
+    DIR *ent = opendir("/dev/input");
+    if(ent) {
+        struct dirent *entry = nullptr;
+        while((entry = readdir(ent))) {
+            std::string name = std::string(entry->d_name);
+            if(name.compare(0, 5, "event") != 0) continue;
+
+            if(tryOpen("/dev/input/" + name, sameDevice)) {
+                found = true;
+                break;
             }
         }
-                
         closedir(ent);
     }
-
     return found;
 }
 
+bool TouchDriver::tryOpen(const std::string & path, bool sameDevice) {
+    struct stat fileinfo;
+    if(stat(path.c_str(), &fileinfo) || !S_ISCHR(fileinfo.st_mode)) {
+        return false;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if(fd < 0) {
+        if(errno == EACCES) {
+            //sudo usermod -a -G input $USER
+            std::cerr << "no permisions for " << path << ". Try running with sudo or adding your user to the 'input' group." << std::endl;
+        }
+        return false;
+    }
+
+    libevdev * dev = nullptr;
+    int rc = libevdev_new_from_fd(fd, &dev);
+    if(rc<0) {
+        std::cerr << "Failed to init libevdev" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    bool res = libevdev_has_event_code(dev, EV_ABS, ABS_MT_SLOT) &&
+                    libevdev_has_event_code(dev, EV_ABS, ABS_MT_TRACKING_ID) &&
+                    libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_X)  &&
+                    libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_Y);
+
+    if(res && sameDevice) {
+        const char * uniq = libevdev_get_uniq(dev);
+        res = libevdev_get_id_vendor(dev) == _vendor &&
+                libevdev_get_id_product(dev) == _product &&
+                _uniq == (uniq ? uniq : "");
+    }
+
+    if(!res) {
+        libevdev_free(dev);
+        close(fd);
+        return false;
+    }
+
+    //only the touchscreen gets grabbed
+    //TODO: if app terminates unexpectedly(crash or smth) than regular input won't be restored...?
+    rc = libevdev_grab(dev, LIBEVDEV_GRAB);
+    if(rc < 0) {
+        std::cerr << "Failed to grab " << path << ", other clients will see touches too" << std::endl;
+    }
+
+    attach(fd, dev, path);
+    return true;
+}
+
+//capabilities/abs is a bitmap printed as hex longs, most significant word first
+bool TouchDriver::sysfsIsMultitouch(const std::string & sysDevice) {
+    std::ifstream file(sysDevice + "capabilities/abs");
+    if(!file) return false;
+
+    std::vector<unsigned long long> words;
+    std::string word;
+    while(file >> word) {
+        words.push_back(std::strtoull(word.c_str(), nullptr, 16));
+    }
+    std::reverse(words.begin(), words.end());
+
+    //kernel's long, not ours (32 bit userspace on 64 bit kernel is common on Pi)
+    struct utsname uts;
+    int wordBits = (uname(&uts) == 0 && std::strstr(uts.machine, "64")) ? 64 : 32;
+
+    auto hasBit = [&](int bit) {
+        std::size_t idx = bit / wordBits;
+        return idx < words.size() && (words[idx] >> (bit % wordBits)) & 1ULL;
+    };
+    return hasBit(ABS_MT_SLOT) && hasBit(ABS_MT_TRACKING_ID) &&
+            hasBit(ABS_MT_POSITION_X) && hasBit(ABS_MT_POSITION_Y);
+}
+
+bool TouchDriver::sysfsSameIdentity(const std::string & sysDevice) {
+    auto readLine = [](const std::string & path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    };
+    int vendor = std::strtol(readLine(sysDevice + "id/vendor").c_str(), nullptr, 16);
+    int product = std::strtol(readLine(sysDevice + "id/product").c_str(), nullptr, 16);
+    return vendor == _vendor && product == _product && readLine(sysDevice + "uniq") == _uniq;
+}
+
+//cache line: "<vendor> <product> <path> <uniq>", vendor/product in hex, one device per line
+bool TouchDriver::loadDeviceCache() {
+    if(_cachePath.empty()) return false;
+
+    std::ifstream file(_cachePath);
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string path;
+        std::string uniq;
+        in >> std::hex >> _vendor >> _product >> path;
+        if(!in) continue;
+        std::getline(in >> std::ws, uniq);
+        _uniq = uniq;
+
+        //node numbers change between boots, tryOpen checks it's still the same device
+        if(tryOpen(path, true)) {
+            return true;
+        }
+    }
+    _vendor = 0;
+    _product = 0;
+    _uniq.clear();
+    return false;
+}
+
+void TouchDriver::saveDeviceCache() {
+    if(_cachePath.empty()) return;
+
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(_cachePath);
+        std::string line;
+        while(std::getline(file, line)) {
+            std::istringstream in(line);
+            int vendor, product;
+            std::string path, uniq;
+            in >> std::hex >> vendor >> product >> path;
+            if(!in) continue;
+            std::getline(in >> std::ws, uniq);
+            //one entry per device, keyed by uniq (and ids, uniq is often empty)
+            if(!(vendor == _vendor && product == _product && uniq == _uniq)) {
+                lines.push_back(line);
+            }
+        }
+    }
+
+    std::ostringstream entry;
+    entry << std::hex << _vendor << " " << _product << " " << _path << " " << _uniq;
+    lines.insert(lines.begin(), entry.str());
+
+    std::ofstream file(_cachePath, std::ios::trunc);
+    for(const auto & line : lines) {
+        file << line << "\n";
+    }
+}
+
+void TouchDriver::attach(int fd, libevdev * dev, const std::string & path) {
+    _fd = fd;
+    _dev = dev;
+    const char * uniq = libevdev_get_uniq(dev);
+    _uniq = uniq ? uniq : "";
+    _path = path;
+    _vendor = libevdev_get_id_vendor(dev);
+    _product = libevdev_get_id_product(dev);
+
+    //get resolution
+    const struct input_absinfo* info = libevdev_get_abs_info(dev, ABS_MT_POSITION_X);
+    _resX = info->maximum;
+    _info.x = { info->minimum, info->maximum, info->fuzz, info->flat, info->resolution };
+    info = libevdev_get_abs_info(dev, ABS_MT_POSITION_Y);
+    _resY = info->maximum;
+    _info.y = { info->minimum, info->maximum, info->fuzz, info->flat, info->resolution };
+
+    const struct input_absinfo* slots = libevdev_get_abs_info(dev, ABS_MT_SLOT);
+    _slotQuery.resize(1 + (slots ? slots->maximum + 1 : _maxFingers));
+
+    _info.magic = CAPTURE_MAGIC;
+    _info.version = CAPTURE_VERSION;
+    _info.slots = _slotQuery.size() - 1;
+    std::strncpy(_info.uniq, _uniq.c_str(), sizeof(_info.uniq) - 1);
+
+    //timestamps in the same clock as steady_clock, so we can compare them with now()
+    _kernelClock = libevdev_set_clock_id(dev, CLOCK_MONOTONIC) == 0;
+    if(!_kernelClock) {
+        std::cerr << "Failed to switch device to CLOCK_MONOTONIC, using read time" << std::endl;
+    }
+
+    //from now on libevdev is only used for capabilities
+    if(_engine == IoEngine::Batched) {
+        applyEventMask();
+    }
+}
+
+//read path got ENODEV: forget the device and end every finger on the next process()
+void TouchDriver::detach() {
+    std::cerr << "Touch device " << _path << " is gone, waiting for it to come back" << std::endl;
+    if(_dev != nullptr) {
+        libevdev_free(_dev);
+        _dev = nullptr;
+    }
+    if(_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _evHead = 0;
+    _evTail = 0;
+    _skipToReport = false;
+
+    for(auto & raw : _raw) {
+        raw.active = false;
+    }
+    _frameTime = now();
+    _resync = true;
+}
+
+bool TouchDriver::handleHotplug() {
+    //drain notifications, we only care that something changed in /dev/input
+    alignas(struct inotify_event) char buf[4096];
+    bool nodeChanged = false;
+    ssize_t len;
+    while((len = read(_inotifyFd, buf, sizeof(buf))) > 0) {
+        for(char * ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event * event = reinterpret_cast<const struct inotify_event*>(ptr);
+            if(event->len && std::strncmp(event->name, "event", 5) == 0) {
+                nodeChanged = true;
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    //IN_CREATE may come before udev fixed permissions, IN_ATTRIB gives a second chance
+    if(!nodeChanged) return false;
+    return reattach();
+}
+
+bool TouchDriver::reattach() {
+    if(_fd >= 0 || _type == DriverType::Fake) return false;
+
+    if(scanDevices(true)) {
+        std::cout << "Touch device is back: " << _path << std::endl;
+        return true;
+    }
+    return false;
+}
+
 void TouchDriver::printCapabilities() {
+    if(_type == DriverType::Fake) {
+        std::cout << "Replay: " << _path << std::endl;
+        std::cout << "Name: " << _uniq << std::endl;
+        std::cout << "Resolution: " << _resX << "x" << _resY << ", " << _info.slots << " slots" << std::endl;
+        std::cout << "Records: " << (_replayEnd - _replayCur) << (_replayRealtime ? " (realtime)" : " (fast)") << "\n" << std::endl;
+        return;
+    }
+
     libevdev * dev = _dev;
     std::cout << "Device: " << libevdev_get_name(dev) << std::endl;
     std::cout << "Vendor id: " << libevdev_get_id_vendor(dev) << std::endl;
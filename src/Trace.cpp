@@ -0,0 +1,152 @@
+// Copyright (c) 2025 Cwits
+// Licensed under the MIT License. See LICENSE file in the project root for details.
+
+#include "gestlib/Trace.h"
+#include "gestlib/OneFingerFSM.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace GestLib {
+
+void TraceRing::resize(std::size_t capacity) {
+    if(capacity == 0) {
+        _records.clear();
+        _records.shrink_to_fit();
+        _mask = 0;
+        _head.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    std::size_t size = 1;
+    while(size < capacity) size <<= 1;
+    //assign() touches every page now, not on first records
+    _records.assign(size, TraceRecord{});
+    _mask = size - 1;
+    _head.store(0, std::memory_order_relaxed);
+}
+
+static bool writeAll(int fd, const void * data, std::size_t size) {
+    const char * ptr = static_cast<const char*>(data);
+    while(size > 0) {
+        ssize_t rc = write(fd, ptr, size);
+        if(rc < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        ptr += rc;
+        size -= rc;
+    }
+    return true;
+}
+
+bool TraceRing::dump(int fd) const {
+    std::size_t head = _head.load(std::memory_order_acquire);
+    std::size_t capacity = _records.size();
+    std::size_t count = head < capacity ? head : capacity;
+
+    TraceHeader header = {};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    header.count = count;
+    header.total = head;
+    if(!writeAll(fd, &header, sizeof(header))) return false;
+    if(count == 0) return true;
+
+    //oldest first: tail of the buffer, then its beginning
+    std::size_t start = (head - count) & _mask;
+    std::size_t first = capacity - start < count ? capacity - start : count;
+    if(!writeAll(fd, &_records[start], first * sizeof(TraceRecord))) return false;
+    return writeAll(fd, &_records[0], (count - first) * sizeof(TraceRecord));
+}
+
+void TraceRing::dump(std::ostream & out) const {
+    std::size_t head = _head.load(std::memory_order_acquire);
+    std::size_t capacity = _records.size();
+    std::size_t count = head < capacity ? head : capacity;
+
+    for(std::size_t i = head - count; i < head; ++i) {
+        const TraceRecord & rec = _records[i & _mask];
+        out << rec.timeNs / 1000 << "us ";
+        switch(static_cast<TraceKind>(rec.kind)) {
+            case(TraceKind::State): {
+                out << "state " << OneFingerFSM::stateName(static_cast<OneFingerFSM::state>(rec.value))
+                    << " -> " << OneFingerFSM::stateName(static_cast<OneFingerFSM::state>(rec.code));
+            } break;
+            case(TraceKind::TimerStart): out << "timer " << rec.code << " start " << rec.value << "ms"; break;
+            case(TraceKind::TimerExpire): out << "timer " << rec.code << " expired"; break;
+            case(TraceKind::Gesture): {
+                out << "gesture " << rec.code << " state " << rec.value << " at " << rec.x << "," << rec.y;
+            } break;
+            default: out << "unknown record " << rec.kind; break;
+        }
+        out << '\n';
+    }
+}
+
+static std::atomic<const TraceRing*> crashRing{nullptr};
+static std::atomic<int> crashFd{-1};
+static constexpr int crashSignals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+//whatever was installed before us, put back on uninstall and chained to after the dump
+static struct sigaction previousActions[sizeof(crashSignals) / sizeof(crashSignals[0])];
+static bool crashInstalled = false;
+
+static void crashHandler(int sig, siginfo_t * info, void * context) {
+    const TraceRing * ring = crashRing.exchange(nullptr);
+    int fd = crashFd.load();
+    if(ring && fd >= 0) {
+        ring->dump(fd);
+        fsync(fd);
+    }
+
+    for(std::size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+        if(crashSignals[i] != sig) continue;
+        //previous handler takes over, also for a fault that happens again
+        const struct sigaction & previous = previousActions[i];
+        sigaction(sig, &previous, nullptr);
+        if(previous.sa_flags & SA_SIGINFO) {
+            previous.sa_sigaction(sig, info, context);
+        } else if(previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+            previous.sa_handler(sig);
+        } else {
+            //blocked while in here, default action as soon as we return
+            raise(sig);
+        }
+        return;
+    }
+}
+
+bool dumpTraceOnCrash(const TraceRing * ring, int fd) {
+    crashFd.store(fd);
+    crashRing.store(ring);
+
+    if(!ring) {
+        bool restored = true;
+        for(std::size_t i = 0; crashInstalled && i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+            restored = sigaction(crashSignals[i], &previousActions[i], nullptr) == 0 && restored;
+        }
+        crashInstalled = false;
+        return restored;
+    }
+    //already in place, only ring and fd change
+    if(crashInstalled) return true;
+
+    struct sigaction action = {};
+    action.sa_sigaction = crashHandler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    for(std::size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+        if(sigaction(crashSignals[i], &action, &previousActions[i]) < 0) {
+            //don't leave half of them installed
+            while(i-- > 0) sigaction(crashSignals[i], &previousActions[i], nullptr);
+            return false;
+        }
+    }
+    crashInstalled = true;
+    return true;
+}
+
+}